@@ -0,0 +1,160 @@
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <vector>
+#include "../src/PID.h"
+#include "../src/basic_pid.h"
+#include "../src/simulator.h"
+#include "../src/telemetry_log.h"
+
+/*
+* Instantiates the BasicPID policies next to PID over recorded CTE traces:
+* compile-time gains in double, which must match PID bit for bit; the same
+* with ClampIntegral and ClampOutput, which must match PID with kClamp
+* anti-windup and a clamped output; and the float example documented in
+* basic_pid.h, whose error against the same policies in double must stay
+* within kFloatBound. Reports how far the example's derivative filter moves
+* the output from PID, and the time per update of each.
+*
+* Usage: bench_basic_pid [LOG...]
+* Without logs, traces are recorded from the built-in simulator.
+*/
+
+namespace {
+
+// The steering gains of Controller, as in the basic_pid.h example.
+struct SteerGains {
+  static constexpr double kp() { return 0.212221; }
+  static constexpr double ki() { return 0.00974437; }
+  static constexpr double kd() { return 3.01065; }
+};
+
+// Integral limit of the clamped variant, low enough to bind on the traces.
+const int kIntegralLimit = 1;
+
+// Bound on the float example against double, in steering units.
+const double kFloatBound = 1e-5;
+
+typedef BasicPID<double, pid::Policy<SteerGains> > StaticPID;
+
+typedef BasicPID<double,
+                 pid::Policy<SteerGains, pid::RawDerivative,
+                             pid::ClampIntegral<double, kIntegralLimit>,
+                             pid::ClampOutput<double, -1, 1> > >
+    ClampedPID;
+
+template <typename T>
+using Example = BasicPID<T, pid::Policy<SteerGains,
+                                        pid::LowPassDerivative<T, 1, 2>,
+                                        pid::NoAntiWindup,
+                                        pid::ClampOutput<T, -1, 1> > >;
+
+double Clamp(double u) { return u > 1 ? 1 : (u < -1 ? -1 : u); }
+
+// Runs pid over trace, storing TotalError after every update, and returns
+// the seconds taken.
+template <typename P>
+double Run(P *pid, const std::vector<double> &trace, std::vector<double> *out) {
+
+  typedef typename P::Scalar T;
+  std::vector<T> cte(trace.begin(), trace.end());
+  std::vector<T> u(trace.size());
+  auto start = std::chrono::steady_clock::now();
+  for (size_t k = 0; k < cte.size(); ++k) {
+    pid->UpdateError(cte[k]);
+    u[k] = pid->TotalError();
+  }
+  double s = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  out->assign(u.begin(), u.end());
+  return s;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<std::vector<double> > traces;
+  for (int i = 1; i < argc; ++i) {
+    TelemetryLog log;
+    if (!log.Open(argv[i])) {
+      std::cerr << "Failed to read " << argv[i] << std::endl;
+      return -1;
+    }
+    std::vector<double> trace;
+    for (size_t k = 0; k < log.size(); ++k) trace.push_back(log.records()[k].cte);
+    traces.push_back(trace);
+  }
+  if (traces.empty()) {
+    Track track = Track::Default();
+    Simulator::Params params;
+    params.cte_noise = 0.05;
+    for (unsigned seed = 1; seed <= 4; ++seed) {
+      Controller controller;
+      Simulator sim(track, params, seed);
+      std::vector<double> trace;
+      for (int k = 0; k < 20000 && !sim.OffTrack(); ++k) {
+        Telemetry t = sim.Observe();
+        trace.push_back(t.cte);
+        sim.Step(controller.Update(t.cte, t.speed, t.steering_angle));
+      }
+      traces.push_back(trace);
+    }
+  }
+
+  size_t ticks = 0, static_diff = 0, clamped_diff = 0, clamped = 0;
+  double float_err = 0, filter_diff = 0;
+  double pid_s = 0, static_s = 0, float_s = 0;
+  for (const auto &trace : traces) {
+    std::vector<double> reference, out;
+
+    PID pid;
+    pid.Init(SteerGains::kp(), SteerGains::ki(), SteerGains::kd());
+    pid_s += Run(&pid, trace, &reference);
+
+    StaticPID fixed_gains;
+    static_s += Run(&fixed_gains, trace, &out);
+    for (size_t k = 0; k < trace.size(); ++k) {
+      static_diff += out[k] != reference[k];
+    }
+
+    PID clamp_pid;
+    clamp_pid.Init(SteerGains::kp(), SteerGains::ki(), SteerGains::kd());
+    clamp_pid.SetAntiWindup(AntiWindup::kClamp, kIntegralLimit);
+    ClampedPID clamp_basic;
+    for (size_t k = 0; k < trace.size(); ++k) {
+      clamp_pid.UpdateError(trace[k]);
+      clamp_basic.UpdateError(trace[k]);
+      clamped_diff += Clamp(clamp_pid.TotalError()) != clamp_basic.TotalError();
+      clamped += fabs(clamp_basic.i_error) == kIntegralLimit;
+    }
+
+    Example<float> example;
+    Example<double> example_double;
+    std::vector<double> exact;
+    float_s += Run(&example, trace, &out);
+    Run(&example_double, trace, &exact);
+    for (size_t k = 0; k < trace.size(); ++k) {
+      float_err = fmax(float_err, fabs(out[k] - exact[k]));
+      filter_diff = fmax(filter_diff, fabs(exact[k] - Clamp(reference[k])));
+    }
+    ticks += trace.size();
+  }
+
+  bool ok = static_diff == 0 && clamped_diff == 0 && clamped > 0 &&
+            float_err <= kFloatBound;
+  std::cout << "Traces: " << traces.size() << " Ticks: " << ticks << std::endl;
+  std::cout << "Compile-time gains, outputs differing from PID: "
+            << static_diff << std::endl;
+  std::cout << "ClampIntegral and ClampOutput, outputs differing from PID: "
+            << clamped_diff << " (integral at the limit on " << clamped
+            << " ticks)" << std::endl;
+  std::cout << "float example max error: " << float_err
+            << " (bound " << kFloatBound << "), derivative filter moves the"
+            << " output up to " << filter_diff << " from PID" << std::endl;
+  std::cout << "PID: " << pid_s / ticks * 1e9
+            << " ns/update, compile-time gains: " << static_s / ticks * 1e9
+            << " ns/update, float example: " << float_s / ticks * 1e9
+            << " ns/update" << std::endl;
+  std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}
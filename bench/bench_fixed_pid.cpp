@@ -0,0 +1,192 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <math.h>
+#include <random>
+#include <vector>
+#include "../src/PID.h"
+#include "../src/fixed_pid.h"
+#include "../src/fixed_point.h"
+#include "../src/simulator.h"
+#include "../src/telemetry_log.h"
+
+/*
+* Runs the steering law in Q16.16 next to the double implementation over
+* recorded CTE traces, reports the error and the time per update, and fails
+* if the error exceeds the documented bounds. Q31 arithmetic is checked
+* first: saturation at -1 and just below 1, and products against a rounded
+* reference computed without shifts.
+*
+* Usage: bench_fixed_pid [LOG...]
+* Without logs, traces are recorded from the built-in simulator.
+*/
+
+namespace {
+
+// Bounds checked below, in steering units of [-1, 1].
+const double kSquashBound = 1.5e-4;
+const double kSteerBound = 5e-4;
+
+double Squash(double x) { return 2 / (1 + exp(-x)) - 1; }
+
+// Raw Q31 product rounded to nearest with ties up, using floor division
+// rather than the arithmetic right shift Fixed relies on for negatives.
+int32_t ReferenceQ31Product(int32_t a, int32_t b) {
+  const int64_t one = int64_t(1) << 31;
+  int64_t p = int64_t(a) * b + one / 2;
+  int64_t q = p / one;
+  if (p % one != 0 && p < 0) --q;
+  return Q31::Saturate(q);
+}
+
+// Returns the number of failed Q31 cases, printing each one.
+int CheckQ31() {
+
+  struct Case {
+    const char *what;
+    int32_t raw;
+    int32_t expected;
+  };
+  const double ulp = 1.0 / 2147483648.0;
+  const Case cases[] = {
+    { "Q31(1)", Q31(1.0).raw, INT32_MAX },
+    { "Q31(-1)", Q31(-1.0).raw, INT32_MIN },
+    { "Q31(2)", Q31(2.0).raw, INT32_MAX },
+    { "Q31(-2)", Q31(-2.0).raw, INT32_MIN },
+    { "Q31(-1.5 ulp)", Q31(-1.5 * ulp).raw, -2 },
+    { "-1 * -1", (Q31(-1.0) * Q31(-1.0)).raw, INT32_MAX },
+    { "-(-1)", (-Q31(-1.0)).raw, INT32_MAX },
+    { "0.75 + 0.75", (Q31(0.75) + Q31(0.75)).raw, INT32_MAX },
+    { "-0.75 - 0.75", (Q31(-0.75) - Q31(0.75)).raw, INT32_MIN },
+    { "-1 * 0.5", (Q31(-1.0) * Q31(0.5)).raw, -(1 << 30) },
+    { "-0.5 * 0.5", (Q31(-0.5) * Q31(0.5)).raw, Q31(-0.25).raw },
+    { "-1 ulp * 1 ulp", (Q31::FromRaw(-1) * Q31::FromRaw(1)).raw, 0 },
+    { "-0.5 * 1 ulp", (Q31(-0.5) * Q31::FromRaw(1)).raw, 0 },
+    { "-3 ulp * 0.5", (Q31::FromRaw(-3) * Q31(0.5)).raw, -1 },
+    { "3 ulp * 0.5", (Q31::FromRaw(3) * Q31(0.5)).raw, 2 },
+  };
+  int failed = 0;
+  for (const Case &c : cases) {
+    if (c.raw == c.expected) continue;
+    std::cout << "Q31 " << c.what << ": raw " << c.raw << ", expected "
+              << c.expected << std::endl;
+    ++failed;
+  }
+
+  const int32_t edges[] = { INT32_MIN, INT32_MIN + 1, -(1 << 30), -3, -1, 0,
+                            1, 3, 1 << 30, INT32_MAX };
+  std::vector<std::pair<int32_t, int32_t> > pairs;
+  for (int32_t a : edges) {
+    for (int32_t b : edges) pairs.push_back(std::make_pair(a, b));
+  }
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int32_t> raw(INT32_MIN, INT32_MAX);
+  for (int i = 0; i < 1000000; ++i) {
+    pairs.push_back(std::make_pair(raw(rng), raw(rng)));
+  }
+  for (const auto &p : pairs) {
+    int32_t got = (Q31::FromRaw(p.first) * Q31::FromRaw(p.second)).raw;
+    int32_t expected = ReferenceQ31Product(p.first, p.second);
+    if (got == expected) continue;
+    if (failed < 10) {
+      std::cout << "Q31 raw " << p.first << " * " << p.second << ": "
+                << got << ", expected " << expected << std::endl;
+    }
+    ++failed;
+  }
+  size_t checked = sizeof(cases) / sizeof(cases[0]) + pairs.size();
+  std::cout << "Q31 cases: " << checked << " failed: " << failed << std::endl;
+  return failed;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<std::vector<double> > traces;
+  for (int i = 1; i < argc; ++i) {
+    TelemetryLog log;
+    if (!log.Open(argv[i])) {
+      std::cerr << "Failed to read " << argv[i] << std::endl;
+      return -1;
+    }
+    std::vector<double> trace;
+    for (size_t k = 0; k < log.size(); ++k) trace.push_back(log.records()[k].cte);
+    traces.push_back(trace);
+  }
+  if (traces.empty()) {
+    Track track = Track::Default();
+    Simulator::Params params;
+    params.cte_noise = 0.05;
+    for (unsigned seed = 1; seed <= 4; ++seed) {
+      Controller controller;
+      Simulator sim(track, params, seed);
+      std::vector<double> trace;
+      for (int k = 0; k < 20000 && !sim.OffTrack(); ++k) {
+        Telemetry t = sim.Observe();
+        trace.push_back(t.cte);
+        sim.Step(controller.Update(t.cte, t.speed, t.steering_angle));
+      }
+      traces.push_back(trace);
+    }
+  }
+
+  int q31_failed = CheckQ31();
+
+  // Squash alone, on a dense grid well past the table range.
+  double squash_err = 0;
+  for (double x = -20; x <= 20; x += 1e-4) {
+    double e = fabs(FixedSquash(Q16_16(x)).ToDouble() - Squash(x));
+    if (e > squash_err) squash_err = e;
+  }
+
+  // Full steering law over every trace.
+  const double Kp = 0.212221, Ki = 0.00974437, Kd = 3.01065;
+  double steer_err = 0, sq_sum = 0;
+  size_t ticks = 0;
+  double double_s = 0, fixed_s = 0;
+  typedef std::chrono::steady_clock Clock;
+  for (const auto &trace : traces) {
+    std::vector<double> out_double(trace.size()), out_fixed(trace.size());
+    std::vector<Q16_16> cte_fixed(trace.begin(), trace.end());
+
+    PID pid;
+    pid.Init(Kp, Ki, Kd);
+    auto start = Clock::now();
+    for (size_t k = 0; k < trace.size(); ++k) {
+      pid.UpdateError(trace[k]);
+      out_double[k] = Squash(pid.TotalError());
+    }
+    double_s += std::chrono::duration<double>(Clock::now() - start).count();
+
+    FixedPID fixed;
+    fixed.Kp = Kp;
+    fixed.Ki = Ki;
+    fixed.Kd = Kd;
+    start = Clock::now();
+    for (size_t k = 0; k < trace.size(); ++k) {
+      fixed.UpdateError(cte_fixed[k]);
+      out_fixed[k] = FixedSquash(fixed.TotalError()).ToDouble();
+    }
+    fixed_s += std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (size_t k = 0; k < trace.size(); ++k) {
+      double e = fabs(out_fixed[k] - out_double[k]);
+      if (e > steer_err) steer_err = e;
+      sq_sum += e * e;
+    }
+    ticks += trace.size();
+  }
+
+  bool ok = q31_failed == 0 && squash_err <= kSquashBound &&
+            steer_err <= kSteerBound;
+  std::cout << "Traces: " << traces.size() << " Ticks: " << ticks << std::endl;
+  std::cout << "Squash max error:   " << squash_err
+            << " (bound " << kSquashBound << ")" << std::endl;
+  std::cout << "Steering max error: " << steer_err
+            << " RMS: " << sqrt(sq_sum / ticks)
+            << " (bound " << kSteerBound << ")" << std::endl;
+  std::cout << "double: " << double_s / ticks * 1e9 << " ns/update, Q16.16: "
+            << fixed_s / ticks * 1e9 << " ns/update" << std::endl;
+  std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../src/fleet_sim.h"
+
+/*
+* Drives N cars with perturbed steering gains and their own noise seeds
+* through RunEpisode, one at a time and spread over a thread pool, and as a
+* FleetSim, single threaded and on the same pool. Checks that every car
+* gives the same EpisodeResult bit for bit and that some cars left the
+* road, so both ends of an episode are covered, and reports control ticks
+* per second.
+*
+* Usage: bench_fleet [cars] [steps] [threads]
+*/
+
+namespace {
+
+bool Same(const EpisodeResult &a, const EpisodeResult &b) {
+  return a.steps == b.steps && a.off_track == b.off_track &&
+         !memcmp(&a.cte_sq_sum, &b.cte_sq_sum, sizeof(double)) &&
+         !memcmp(&a.max_cte, &b.max_cte, sizeof(double)) &&
+         !memcmp(&a.distance, &b.distance, sizeof(double));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const size_t cars = argc > 1 ? atoi(argv[1]) : 1024;
+  const int steps = argc > 2 ? atoi(argv[2]) : 2000;
+  const size_t threads = argc > 3 ? atoi(argv[3]) : 0;
+  typedef std::chrono::steady_clock Clock;
+
+  Track track = Track::Default();
+  Simulator::Params params;
+  params.cte_noise = 0.05;
+
+  // Gains from 0.1 to 2 times the tuned ones; about one car in ten leaves
+  // the road within the default 2000 steps.
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> scale(0.1, 2);
+  Controller tuned;
+  std::vector<double> gains(cars * 3);
+  for (size_t i = 0; i < cars; ++i) {
+    gains[i * 3] = tuned.pid_steer.Kp * scale(rng);
+    gains[i * 3 + 1] = tuned.pid_steer.Ki * scale(rng);
+    gains[i * 3 + 2] = tuned.pid_steer.Kd * scale(rng);
+  }
+
+  std::vector<EpisodeResult> scalar(cars);
+  auto run_car = [&](size_t i) {
+    Controller controller;
+    controller.pid_steer.Init(gains[i * 3], gains[i * 3 + 1], gains[i * 3 + 2]);
+    Simulator sim(track, params, i);
+    scalar[i] = RunEpisode(controller, sim, steps);
+  };
+  auto start = Clock::now();
+  for (size_t i = 0; i < cars; ++i) run_car(i);
+  double scalar_s = std::chrono::duration<double>(Clock::now() - start).count();
+  long scalar_ticks = 0;
+  for (const EpisodeResult &r : scalar) scalar_ticks += r.steps;
+
+  // The plain alternative to FleetSim: whole episodes as pool jobs.
+  ThreadPool pool(threads);
+  std::vector<EpisodeResult> first = scalar;
+  start = Clock::now();
+  pool.Run(cars, run_car);
+  double pooled_s = std::chrono::duration<double>(Clock::now() - start).count();
+  bool identical = true;
+  for (size_t i = 0; i < cars; ++i) {
+    identical = identical && Same(first[i], scalar[i]);
+  }
+
+  double fleet_s[2];
+  for (int pass = 0; pass < 2; ++pass) {
+    FleetSim fleet(track, params, cars);
+    for (size_t i = 0; i < cars; ++i) {
+      fleet.steer.Init(i, gains[i * 3], gains[i * 3 + 1], gains[i * 3 + 2]);
+      fleet.Reset(i, i);
+    }
+    start = Clock::now();
+    fleet.Run(steps, pass ? &pool : nullptr);
+    fleet_s[pass] = std::chrono::duration<double>(Clock::now() - start).count();
+    for (size_t i = 0; i < cars; ++i) {
+      identical = identical && Same(scalar[i], fleet.Result(i));
+    }
+  }
+
+  size_t off = 0;
+  for (const EpisodeResult &r : scalar) off += r.off_track;
+  std::cout << "Cars: " << cars << " Ticks: " << scalar_ticks
+            << " Off track: " << off << std::endl;
+  std::cout << "Scalar:            " << scalar_ticks / scalar_s
+            << " ticks/s" << std::endl;
+  std::cout << "Scalar, " << pool.size() << " threads:   "
+            << scalar_ticks / pooled_s << " ticks/s" << std::endl;
+  std::cout << "FleetSim:          " << scalar_ticks / fleet_s[0]
+            << " ticks/s" << std::endl;
+  std::cout << "FleetSim, " << pool.size() << " threads: "
+            << scalar_ticks / fleet_s[1] << " ticks/s" << std::endl;
+  std::cout << "Bit-identical: " << (identical ? "yes" : "no") << std::endl;
+  if (off == 0) std::cout << "No car left the road" << std::endl;
+  return identical && off > 0 ? 0 : 1;
+}
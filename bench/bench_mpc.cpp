@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <math.h>
+#include "../src/simulator.h"
+
+/*
+* Drives the built-in track with MPC steering and reports the time of every
+* control tick (p50 / p99 / max), the active set iterations per solve and how
+* often the iteration cap was reached, next to the tracking error of MPC and
+* PID at the same speed.
+*
+* Usage: bench_mpc [target mph] [steps] [cte noise]
+*/
+int main(int argc, char *argv[]) {
+  const double speed = argc > 1 ? atof(argv[1]) : 100;
+  const int steps = argc > 2 ? atoi(argv[2]) : 20000;
+  typedef std::chrono::steady_clock Clock;
+
+  Track track = Track::Default();
+  Simulator::Params params;
+  params.cte_noise = argc > 3 ? atof(argv[3]) : 0.05;
+
+  Controller mpc;
+  mpc.steer_mode = SteerMode::kMPC;
+  mpc.target_speed = speed;
+  Simulator sim(track, params, 1);
+
+  std::vector<double> ns;
+  ns.reserve(steps);
+  long iterations = 0;
+  int capped = 0;
+  EpisodeResult r = { 0, 0, 0, 0, false };
+  for (int i = 0; i < steps && !sim.OffTrack(); ++i) {
+    Telemetry t = sim.Observe();
+    auto start = Clock::now();
+    Command cmd = mpc.Update(t.cte, t.speed, t.steering_angle);
+    ns.push_back(std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count());
+    iterations += mpc.mpc_steer.iterations();
+    if (mpc.mpc_steer.iterations() == MpcSteer::kMaxIterations) ++capped;
+    sim.Step(cmd);
+    r.steps += 1;
+    r.cte_sq_sum += sim.cte * sim.cte;
+    r.max_cte = fmax(r.max_cte, fabs(sim.cte));
+    r.off_track = sim.OffTrack();
+  }
+
+  Controller pid;
+  pid.target_speed = speed;
+  Simulator pid_sim(track, params, 1);
+  EpisodeResult p = RunEpisode(pid, pid_sim, steps);
+
+  std::vector<double> sorted = ns;
+  std::sort(sorted.begin(), sorted.end());
+  size_t n = sorted.size();
+  std::cout << "Target " << speed << " mph, " << n << " ticks, horizon "
+            << MpcSteer::kHorizon << std::endl;
+  std::cout << "Tick ns  p50 " << sorted[n / 2]
+            << "  p99 " << sorted[n * 99 / 100]
+            << "  max " << sorted[n - 1] << std::endl;
+  std::cout << "Active set iterations  mean "
+            << static_cast<double>(iterations) / n
+            << "  at cap (" << MpcSteer::kMaxIterations << ") "
+            << 100.0 * capped / n << "%" << std::endl;
+  std::cout << "MPC  CTE RMS " << sqrt(r.Mse()) << "  max " << r.max_cte
+            << (r.off_track ? "  OFF TRACK" : "") << std::endl;
+  std::cout << "PID  CTE RMS " << sqrt(p.Mse()) << "  max " << p.max_cte
+            << (p.off_track ? "  OFF TRACK" : "") << std::endl;
+  return r.off_track ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <math.h>
+#include <vector>
+#include "../src/output_shaping.h"
+
+/*
+* Measures every steering shape against 2 / (1 + exp(-x)) - 1: max error
+* on a dense grid, and time per value for the scalar and batch forms.
+* Fails if an approximation exceeds the bound documented in
+* output_shaping.h or if the batch form differs from the scalar form.
+*
+* Usage: bench_output_shaping [ITERATIONS]
+*/
+
+namespace {
+
+struct Case {
+  SteerShape shape;
+  double bound; // max absolute error, negative when not an approximation
+};
+
+const Case kCases[] = {
+  { SteerShape::kSigmoid, 0 },
+  { SteerShape::kClamp, -1 },
+  { SteerShape::kRationalTanh, 9.6e-5 },
+  { SteerShape::kPolySigmoid, 3.5e-9 },
+};
+
+double Exact(double x) { return 2 / (1 + exp(-x)) - 1; }
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+  typedef std::chrono::steady_clock Clock;
+
+  // Raw steering outputs seen in practice sit within a few units of zero.
+  std::vector<double> grid;
+  for (double x = -20; x <= 20; x += 1e-4) grid.push_back(x);
+  std::vector<double> inputs(4096);
+  srand(1);
+  for (double &x : inputs) x = 8.0 * rand() / RAND_MAX - 4.0;
+  std::vector<double> out(inputs.size()), grid_out(grid.size());
+
+  bool ok = true;
+  double checksum = 0;
+  for (const Case &c : kCases) {
+    double max_err = 0;
+    size_t mismatches = 0;
+    ShapeSteerBatch(c.shape, grid.data(), grid_out.data(), grid.size());
+    for (size_t k = 0; k < grid.size(); ++k) {
+      double v = ShapeSteer(c.shape, grid[k]);
+      double e = fabs(v - Exact(grid[k]));
+      if (e > max_err) max_err = e;
+      if (memcmp(&v, &grid_out[k], sizeof(v))) ++mismatches;
+    }
+
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      for (size_t k = 0; k < inputs.size(); ++k) {
+        checksum += ShapeSteer(c.shape, inputs[k] + i * 1e-9);
+      }
+    }
+    double scalar_ns = std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count() / (iterations * inputs.size());
+
+    start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      inputs[i % inputs.size()] += 1e-9;
+      ShapeSteerBatch(c.shape, inputs.data(), out.data(), out.size());
+      checksum += out[i % out.size()];
+    }
+    double batch_ns = std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count() / (iterations * inputs.size());
+
+    bool pass = (c.bound < 0 || max_err <= c.bound) && mismatches == 0;
+    ok = ok && pass;
+    std::cout << SteerShapeName(c.shape) << ":\t"
+              << scalar_ns << " ns scalar, " << batch_ns << " ns batch";
+    if (c.bound < 0) {
+      std::cout << ", max deviation " << max_err
+                << (pass ? "" : " FAIL") << std::endl;
+    } else {
+      std::cout << ", max error " << max_err << " (bound " << c.bound << ")"
+                << (pass ? "" : " FAIL") << std::endl;
+    }
+    if (mismatches) {
+      std::cout << "  batch differs from scalar for " << mismatches
+                << " inputs" << std::endl;
+    }
+  }
+  std::cout << "(checksum " << checksum << ")" << std::endl;
+  std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../src/PID.h"
+#include "../src/pid_bank.h"
+
+/*
+* Steps N controllers for a number of ticks, once as a vector of scalar PID
+* objects and once as a PIDBank, checks that both produce the same bits and
+* reports controllers per second.
+*
+* Usage: bench_pid_bank [controllers] [ticks]
+*/
+int main(int argc, char *argv[]) {
+  const size_t n = argc > 1 ? atoi(argv[1]) : 4096;
+  const int ticks = argc > 2 ? atoi(argv[2]) : 2000;
+  typedef std::chrono::steady_clock Clock;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> gain(0, 1);
+  std::normal_distribution<double> noise(0, 1);
+
+  std::vector<PID> scalar(n);
+  PIDBank bank(n);
+  for (size_t k = 0; k < n; ++k) {
+    double kp = gain(rng), ki = gain(rng) * 0.01, kd = gain(rng) * 3;
+    scalar[k].Init(kp, ki, kd);
+    bank.Init(k, kp, ki, kd);
+  }
+
+  // Pre-generate inputs so both runs see the same ctes.
+  std::vector<double> cte(n * 16);
+  for (auto &c : cte) c = noise(rng);
+
+  std::vector<double> out_scalar(n), out_bank(n);
+  double checksum = 0;
+  bool identical = true;
+
+  auto start = Clock::now();
+  for (int t = 0; t < ticks; ++t) {
+    const double *c = &cte[(t % 16) * n];
+    for (size_t k = 0; k < n; ++k) {
+      scalar[k].UpdateError(c[k]);
+      out_scalar[k] = scalar[k].TotalError();
+    }
+    checksum += out_scalar[t % n];
+  }
+  double scalar_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  for (int t = 0; t < ticks; ++t) {
+    bank.Update(&cte[(t % 16) * n], out_bank.data());
+    checksum += out_bank[t % n];
+  }
+  double bank_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+  for (size_t k = 0; k < n; ++k) {
+    identical = identical &&
+        memcmp(&out_scalar[k], &out_bank[k], sizeof(double)) == 0 &&
+        memcmp(&scalar[k].i_error, &bank.i_error[k], sizeof(double)) == 0;
+  }
+
+  double updates = static_cast<double>(n) * ticks;
+  std::cout << "Controllers: " << n << " Ticks: " << ticks << std::endl;
+  std::cout << "PID:     " << updates / scalar_s << " controllers/s" << std::endl;
+  std::cout << "PIDBank: " << updates / bank_s << " controllers/s" << std::endl;
+  std::cout << "Bit-identical: " << (identical ? "yes" : "NO") << std::endl;
+  std::cout << "(checksum " << checksum << ")" << std::endl;
+  return identical ? 0 : 1;
+}
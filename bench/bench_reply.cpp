@@ -0,0 +1,53 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "../src/json.hpp"
+#include "../src/reply_writer.h"
+
+// for convenience
+using json = nlohmann::json;
+
+/*
+* Compares building the steer reply through nlohmann::json::dump with the
+* in-place ReplyWriter.
+*/
+int main(int argc, char *argv[]) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  typedef std::chrono::steady_clock Clock;
+
+  // Vary the inputs so neither path can be hoisted out of the loop.
+  double steer = -0.7311;
+  double throttle = 0.4182;
+  size_t checksum = 0;
+
+  auto start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    json msgJson;
+    msgJson["steering_angle"] = steer + i * 1e-7;
+    msgJson["throttle"] = throttle - i * 1e-7;
+    auto msg = "42[\"steer\"," + msgJson.dump() + "]";
+    checksum += msg.length();
+  }
+  double json_ns = std::chrono::duration<double, std::nano>(
+      Clock::now() - start).count() / iterations;
+
+  ReplyWriter reply;
+  start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    reply.WriteSteer(steer + i * 1e-7, throttle - i * 1e-7);
+    checksum += reply.length();
+  }
+  double writer_ns = std::chrono::duration<double, std::nano>(
+      Clock::now() - start).count() / iterations;
+
+  reply.WriteSteer(steer, throttle);
+  std::cout << "sample:       " << std::string(reply.data(), reply.length())
+            << std::endl;
+  std::cout << "json::dump:   " << json_ns << " ns/reply" << std::endl;
+  std::cout << "ReplyWriter:  " << writer_ns << " ns/reply" << std::endl;
+  std::cout << "speedup:      " << json_ns / writer_ns << "x" << std::endl;
+  std::cout << "(checksum " << checksum << ")" << std::endl;
+  return 0;
+}
@@ -0,0 +1,359 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include "../src/config.h"
+#include "../src/json.hpp"
+#include "../src/session.h"
+#include "../src/simulator.h"
+#include "../src/telemetry_log.h"
+
+// for convenience
+using json = nlohmann::json;
+
+/*
+* Regression benchmark over a corpus of recorded telemetry. Each log is fed
+* through Controller and through the full Session::OnMessage path,
+* reporting ticks/s and heap allocations per tick. Throughput limits are
+* relative to a fixed calibration loop timed in the same process, so that
+* they hold on slower or faster machines, and come in two sets, for
+* optimized and unoptimized builds, since the ratio moves about threefold
+* with the optimization level; each floor is about half the ratio measured
+* for its build, so a twofold slowdown fails. Allocation and quality limits
+* are absolute.
+*
+* The scenario each log was recorded from is then driven again in closed
+* loop with the same seed, reporting CTE RMS and max, the RMS steering jerk
+* and how many commands differ from the recording. Scenarios with frame
+* jitter drive the timed update, as the server does, so all their commands
+* differ from the per-frame recording; their limits fail if the steering
+* derivative goes unfiltered. The log is also replayed through the timed
+* update at the nominal frame period, which with the filter off must give
+* exactly the per-frame commands.
+*
+* Exits non-zero if any result is worse than the thresholds file. Logs are
+* found relative to the thresholds file; record new ones with pid_sim
+* --record and the scenario's flags.
+*
+* Usage: pid_bench [THRESHOLDS] [--runs N]
+* THRESHOLDS defaults to thresholds.json in the source tree's bench
+* directory, so the benchmark runs from any working directory.
+*/
+
+#ifndef PID_BENCH_DIR
+#define PID_BENCH_DIR "../bench"
+#endif
+
+// Set of throughput limits that applies to this build.
+#ifdef __OPTIMIZE__
+#define PID_BENCH_BUILD "optimized"
+#else
+#define PID_BENCH_BUILD "unoptimized"
+#endif
+
+namespace {
+
+std::atomic<uint64_t> allocations(0);
+
+struct Scenario {
+  std::string name;
+  std::string log;
+  ControllerConfig config;
+  double noise;
+  double jitter;              // frame period spread, closed loop timed if > 0
+  unsigned seed;
+  double min_pid_speed;       // ticks per calibration iteration
+  double min_session_speed;
+  double max_cte_rms;
+  double max_cte_max;
+  double max_jerk;
+};
+
+struct Limits {
+  double max_pid_allocations;
+  double max_session_allocations;
+  std::vector<Scenario> scenarios;
+};
+
+bool LoadLimits(const std::string &path, Limits *limits, std::string *error) {
+
+  std::ifstream in(path);
+  if (!in) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  size_t slash = path.rfind('/');
+  std::string dir = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+  try {
+    json j = json::parse(buffer.str());
+    limits->max_pid_allocations = j["max_allocations_per_tick"]["pid"];
+    limits->max_session_allocations = j["max_allocations_per_tick"]["session"];
+    for (const json &c : j["corpus"]) {
+      Scenario s;
+      s.name = c["name"];
+      s.log = dir + c["log"].get<std::string>();
+      if (!s.config.Parse(c["config"].dump(), error)) {
+        *error = s.name + ": " + *error;
+        return false;
+      }
+      s.noise = c["noise"];
+      s.jitter = c.value("jitter", 0.0);
+      s.seed = c["seed"];
+      const json &speed = c["min_relative_throughput"][PID_BENCH_BUILD];
+      s.min_pid_speed = speed["pid"];
+      s.min_session_speed = speed["session"];
+      s.max_cte_rms = c["max_cte_rms"];
+      s.max_cte_max = c["max_cte_max"];
+      s.max_jerk = c["max_jerk"];
+      limits->scenarios.push_back(s);
+    }
+  } catch (const std::exception &e) {
+    *error = path + ": " + e.what();
+    return false;
+  }
+  return true;
+}
+
+struct Throughput {
+  double ticks_per_second;
+  double allocations_per_tick;
+};
+
+template <typename F>
+Throughput Measure(size_t ticks, int runs, F tick) {
+
+  typedef std::chrono::steady_clock Clock;
+  uint64_t before = allocations.load();
+  auto start = Clock::now();
+  for (int run = 0; run < runs; ++run) {
+    for (size_t i = 0; i < ticks; ++i) tick(run, i);
+  }
+  double wall = std::chrono::duration<double>(Clock::now() - start).count();
+  Throughput t;
+  t.ticks_per_second = ticks * runs / wall;
+  t.allocations_per_tick =
+      static_cast<double>(allocations.load() - before) / (ticks * runs);
+  return t;
+}
+
+// Iterations per second of a small fixed workload that does not depend on
+// the code under test: a PI loop closed around a damped plant, with one
+// sin() per iteration. Best of several rounds, to skip scheduling noise.
+double CalibrationRate() {
+
+  typedef std::chrono::steady_clock Clock;
+  const int kIterations = 200000;
+  volatile double sink = 0;
+  double best = 0;
+  for (int round = 0; round < 5; ++round) {
+    double x = 0, v = 0, integral = 0;
+    auto start = Clock::now();
+    for (int k = 0; k < kIterations; ++k) {
+      double e = sin(0.001 * k) - x;
+      integral += e;
+      double u = 0.2 * e + 0.01 * integral - 3 * v;
+      v += 0.05 * (u - 0.1 * v);
+      x += 0.05 * v;
+    }
+    sink = sink + x;
+    double wall = std::chrono::duration<double>(Clock::now() - start).count();
+    best = fmax(best, kIterations / wall);
+  }
+  return best;
+}
+
+} // namespace
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+// GCC pairs the free below with the new above once both are inlined.
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *p) noexcept {
+  free(p);
+}
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+int main(int argc, char *argv[]) {
+  std::string path = PID_BENCH_DIR "/thresholds.json";
+  int runs = 20;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+    } else if (argv[i][0] != '-') {
+      path = argv[i];
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [THRESHOLDS] [--runs N]"
+                << std::endl;
+      return -1;
+    }
+  }
+
+  Limits limits;
+  std::string error;
+  if (!LoadLimits(path, &limits, &error)) {
+    std::cerr << error << std::endl;
+    return -1;
+  }
+
+  Track track = Track::Default();
+  std::vector<std::string> failures;
+  char line[256];
+  const double calibration = CalibrationRate();
+  std::printf("calibration: %.0f iterations/s, %s limits\n", calibration,
+              PID_BENCH_BUILD);
+  std::printf("%-14s %12s %8s %12s %8s %8s %8s %8s %8s\n", "scenario",
+              "pid tick/s", "alloc", "session t/s", "alloc", "cte rms",
+              "cte max", "jerk", "changed");
+  for (const Scenario &s : limits.scenarios) {
+    TelemetryLog log;
+    if (!log.Open(s.log)) {
+      std::cerr << "Failed to read " << s.log << std::endl;
+      return -1;
+    }
+    const LogRecord *records = log.records();
+    const size_t n = log.size();
+
+    // Controller alone, one fresh copy per run.
+    Controller base;
+    s.config.ApplyTo(&base, false);
+    std::vector<Controller> controllers(runs, base);
+    Throughput pid = Measure(n, runs, [&](int run, size_t i) {
+      const LogRecord &r = records[i];
+      controllers[run].Update(r.cte, r.speed, r.steering_angle);
+    });
+
+    // The timed update at the nominal rate, against the per-frame one; the
+    // derivative filter is the only intended difference.
+    Controller per_frame = base, timed = base;
+    timed.SetTiming(base.frame_period(), 0);
+    size_t timed_changed = 0;
+    for (size_t i = 0; i < n; ++i) {
+      const LogRecord &r = records[i];
+      Command a = per_frame.Update(r.cte, r.speed, r.steering_angle);
+      Command b = timed.Update(r.cte, r.speed, r.steering_angle,
+                               base.frame_period());
+      if (a.steering_angle != b.steering_angle || a.throttle != b.throttle) {
+        ++timed_changed;
+      }
+    }
+
+    // Full message path, frames rendered beforehand.
+    std::vector<std::string> frames(n);
+    for (size_t i = 0; i < n; ++i) {
+      std::snprintf(line, sizeof(line),
+                    "42[\"telemetry\",{\"cte\":\"%.17g\",\"speed\":\"%.17g\","
+                    "\"steering_angle\":\"%.17g\",\"throttle\":\"0\"}]",
+                    records[i].cte, records[i].speed,
+                    records[i].steering_angle);
+      frames[i] = line;
+    }
+    ConfigStore store(s.config);
+    Outgoing out[Session::kMaxReplies];
+    {
+      // Lazily built statistics must not count as per-tick allocations.
+      Session warm_up(&store);
+      for (const std::string &f : frames) {
+        warm_up.OnMessage(f.data(), f.size(), out);
+      }
+    }
+    std::vector<std::unique_ptr<Session>> sessions;
+    for (int run = 0; run < runs; ++run) {
+      sessions.emplace_back(new Session(&store, nullptr, run));
+    }
+    Throughput session = Measure(n, runs, [&](int run, size_t i) {
+      sessions[run]->OnMessage(frames[i].data(), frames[i].size(), out);
+    });
+    sessions.clear();
+
+    // The recorded scenario in closed loop.
+    Controller controller = base;
+    Simulator::Params params;
+    params.cte_noise = s.noise;
+    params.dt_jitter = s.jitter;
+    Simulator sim(track, params, s.seed);
+    double cte_sq_sum = 0, cte_max = 0, jerk_sq_sum = 0;
+    double steer[3] = { 0, 0, 0 };
+    size_t changed = 0, steps = 0;
+    for (size_t i = 0; i < n && !sim.OffTrack(); ++i) {
+      Telemetry t = sim.Observe();
+      Command cmd = s.jitter > 0 ? controller.Update(t.cte, t.speed,
+                                                    t.steering_angle,
+                                                    sim.frame_dt)
+                                 : controller.Update(t.cte, t.speed,
+                                                    t.steering_angle);
+      if (cmd.steering_angle != records[i].steer_command ||
+          cmd.throttle != records[i].throttle_command) {
+        ++changed;
+      }
+      sim.Step(cmd);
+      ++steps;
+      cte_sq_sum += sim.cte * sim.cte;
+      cte_max = fmax(cte_max, fabs(sim.cte));
+      steer[0] = steer[1];
+      steer[1] = steer[2];
+      steer[2] = cmd.steering_angle;
+      if (i >= 2) {
+        double jerk = (steer[2] - 2 * steer[1] + steer[0]) /
+                      (params.dt * params.dt);
+        jerk_sq_sum += jerk * jerk;
+      }
+    }
+    double cte_rms = sqrt(cte_sq_sum / steps);
+    double jerk_rms = steps > 2 ? sqrt(jerk_sq_sum / (steps - 2)) : 0;
+
+    std::printf("%-14s %12.0f %8.2f %12.0f %8.2f %8.4f %8.4f %8.2f %8zu\n",
+                s.name.c_str(), pid.ticks_per_second, pid.allocations_per_tick,
+                session.ticks_per_second, session.allocations_per_tick,
+                cte_rms, cte_max, jerk_rms, changed);
+
+    auto check = [&](bool ok, const char *what, double value, double limit) {
+      if (ok) return;
+      std::snprintf(line, sizeof(line), "%s: %s %g, limit %g", s.name.c_str(),
+                    what, value, limit);
+      failures.push_back(line);
+    };
+    double pid_speed = pid.ticks_per_second / calibration;
+    double session_speed = session.ticks_per_second / calibration;
+    check(pid_speed >= s.min_pid_speed, "pid ticks per calibration iteration",
+          pid_speed, s.min_pid_speed);
+    check(session_speed >= s.min_session_speed,
+          "session ticks per calibration iteration", session_speed,
+          s.min_session_speed);
+    check(pid.allocations_per_tick <= limits.max_pid_allocations,
+          "pid allocations/tick", pid.allocations_per_tick,
+          limits.max_pid_allocations);
+    check(session.allocations_per_tick <= limits.max_session_allocations,
+          "session allocations/tick", session.allocations_per_tick,
+          limits.max_session_allocations);
+    check(timed_changed == 0, "timed update commands differing",
+          timed_changed, 0);
+    check(steps == n, "steps before leaving the road", steps, n);
+    check(cte_rms <= s.max_cte_rms, "cte rms", cte_rms, s.max_cte_rms);
+    check(cte_max <= s.max_cte_max, "cte max", cte_max, s.max_cte_max);
+    check(jerk_rms <= s.max_jerk, "steering jerk", jerk_rms, s.max_jerk);
+  }
+
+  for (const std::string &f : failures) std::printf("FAIL %s\n", f.c_str());
+  if (failures.empty()) std::printf("All within %s\n", path.c_str());
+  return failures.empty() ? 0 : 1;
+}
@@ -2,11 +2,21 @@
 
 using namespace std;
 
-/*
-* TODO: Complete the PID class.
-*/
+namespace {
 
-PID::PID() {}
+// Range of dt accepted by the timed update, in nominal frames.
+const double kMinFrames = 0.1;
+const double kMaxFrames = 10;
+
+} // namespace
+
+PID::PID()
+    : nominal_dt_(0.05),
+      derivative_tau_(0),
+      anti_windup_(AntiWindup::kNone),
+      integral_limit_(0),
+      tracking_gain_(0),
+      saturation_(0) {}
 
 PID::~PID() {}
 
@@ -16,20 +26,77 @@ void PID::Init(double Kp, double Ki, double Kd) {
   this->Ki = Ki;
   this->Kd = Kd;
 
-  p_error = 0;
-  i_error = 0;
-  d_error = 0;
+  Reset();
+  saturation_ = 0;
 }
 
 void PID::UpdateError(double cte) {
 
   d_error = cte - p_error;
+  Integrate(cte);
+  p_error = cte;
+}
+
+void PID::UpdateError(double cte, double dt) {
+
+  double frames = dt > 0 ? dt / nominal_dt_ : 1;
+  if (frames < kMinFrames) frames = kMinFrames;
+  if (frames > kMaxFrames) frames = kMaxFrames;
+
+  double rate = (cte - p_error) / frames;
+  if (derivative_tau_ > 0) {
+    double seconds = frames * nominal_dt_;
+    d_error += seconds / (derivative_tau_ + seconds) * (rate - d_error);
+  } else {
+    d_error = rate;
+  }
+  Integrate(cte * frames);
   p_error = cte;
-  i_error += cte;
 }
 
 double PID::TotalError() {
 
-  return - Kp * p_error - Kd * d_error - Ki * i_error;
+  return BasicPID::TotalError();
 }
 
+void PID::SetTiming(double nominal_dt, double derivative_tau) {
+
+  nominal_dt_ = nominal_dt;
+  derivative_tau_ = derivative_tau;
+}
+
+void PID::SetAntiWindup(AntiWindup mode, double limit, double tracking_gain) {
+
+  anti_windup_ = mode;
+  integral_limit_ = limit;
+  tracking_gain_ = tracking_gain;
+}
+
+void PID::Feedback(double command, double applied) {
+
+  double excess = applied - command;
+  saturation_ = excess < 0 ? 1 : (excess > 0 ? -1 : 0);
+  if (anti_windup_ == AntiWindup::kBackCalculation) {
+    i_error = BackCalculate(i_error, Ki, excess, tracking_gain_);
+  }
+}
+
+double PID::BackCalculate(double i_error, double Ki, double excess,
+                          double tracking_gain) {
+
+  // The integral enters the output as -Ki * i_error.
+  return Ki != 0 ? i_error - tracking_gain * excess / Ki : i_error;
+}
+
+void PID::Integrate(double step) {
+
+  if (anti_windup_ == AntiWindup::kConditional &&
+      saturation_ * -Ki * step > 0) {
+    return;
+  }
+  i_error += step;
+  if (anti_windup_ == AntiWindup::kClamp) {
+    if (i_error > integral_limit_) i_error = integral_limit_;
+    if (i_error < -integral_limit_) i_error = -integral_limit_;
+  }
+}
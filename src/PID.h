@@ -1,22 +1,32 @@
 #ifndef PID_H
 #define PID_H
 
-class PID {
-public:
-  /*
-  * Errors
-  */
-  double p_error;
-  double i_error;
-  double d_error;
+#include "basic_pid.h"
 
-  /*
-  * Coefficients
-  */ 
-  double Kp;
-  double Ki;
-  double Kd;
+/*
+* Integral anti-windup used by PID, driven by the actuator value actually
+* applied (see PID::Feedback):
+*   kNone             integrate without bound
+*   kClamp            keep i_error within [-limit, limit]
+*   kConditional      skip integration steps that would push an output
+*                     saturated on the previous frame further into saturation
+*   kBackCalculation  bleed tracking_gain times the saturation excess out of
+*                     the integral term every frame
+*/
+enum class AntiWindup {
+  kNone,
+  kClamp,
+  kConditional,
+  kBackCalculation
+};
 
+/*
+* Run-time PID on doubles built on BasicPID, adding frame time aware
+* updates and anti-windup. The errors (p_error, i_error, d_error) and
+* coefficients (Kp, Ki, Kd) stay public members.
+*/
+class PID : public BasicPID<double, pid::Policy<pid::RuntimeGains<double> > > {
+public:
   /*
   * Constructor
   */
@@ -37,10 +47,62 @@ public:
   */
   void UpdateError(double cte);
 
+  /*
+  * Update the PID error variables given cross track error and the seconds
+  * since the previous frame. The derivative is the rate of change per
+  * nominal frame, low-pass filtered if SetTiming asks for it, and the
+  * integral adds cte once per nominal frame elapsed, so the gains keep
+  * their per-frame meaning when the frame rate changes. Without the filter
+  * a dt of exactly one nominal frame gives the same result as
+  * UpdateError(cte). dt <= 0 (no previous frame) counts as one nominal
+  * frame, and dt is limited to [0.1, 10] nominal frames so one stall cannot
+  * flood the integral.
+  */
+  void UpdateError(double cte, double dt);
+
   /*
   * Calculate the total PID error.
   */
   double TotalError();
+
+  /*
+  * Timing used by UpdateError(cte, dt): the frame period in seconds the
+  * gains were tuned at, and the time constant in seconds of the derivative
+  * low-pass filter, 0 for none. Defaults to 0.05 and 0.
+  */
+  void SetTiming(double nominal_dt, double derivative_tau);
+
+  /*
+  * Select the anti-windup mode. limit bounds i_error for kClamp and
+  * tracking_gain, in (0, 1], is the fraction of the excess removed per
+  * frame by kBackCalculation. Defaults to kNone.
+  */
+  void SetAntiWindup(AntiWindup mode, double limit = 0,
+                     double tracking_gain = 0);
+
+  /*
+  * Report the actuator value applied for the last TotalError, given the
+  * command computed from it. Both are in the same units and may include
+  * a bias; any difference means the actuator saturated.
+  */
+  void Feedback(double command, double applied);
+
+  /*
+  * The back-calculation step of Feedback: i_error with tracking_gain times
+  * the excess applied - command taken out of the integral term.
+  */
+  static double BackCalculate(double i_error, double Ki, double excess,
+                              double tracking_gain);
+
+private:
+  double nominal_dt_;
+  double derivative_tau_;
+  AntiWindup anti_windup_;
+  double integral_limit_;
+  double tracking_gain_;
+  int saturation_;  // +1 / -1 when the last output was cut from above / below
+
+  void Integrate(double step);
 };
 
 #endif /* PID_H */
@@ -0,0 +1,178 @@
+#ifndef BASIC_PID_H
+#define BASIC_PID_H
+
+/*
+* Header-only PID controller, parameterized on the scalar type and on a
+* policy bundle, so that with compile-time gains the compiler can fold the
+* whole update into a few instructions. T can be float, double or any
+* fixed-point type offering +, binary and unary -, *, comparisons and
+* construction from double.
+*
+* Example with gains fixed at compile time:
+*
+*   struct SteerGains {
+*     static constexpr double kp() { return 0.212221; }
+*     static constexpr double ki() { return 0.00974437; }
+*     static constexpr double kd() { return 3.01065; }
+*   };
+*   typedef pid::LowPassDerivative<float, 1, 2> Filter;
+*   typedef pid::ClampOutput<float, -1, 1> Clamp;
+*   BasicPID<float, pid::Policy<SteerGains, Filter, pid::NoAntiWindup, Clamp>>
+*       steer;
+*
+* bench_basic_pid runs this example and ClampIntegral against PID.
+*/
+
+namespace pid {
+
+/*
+* Gains set at run time. Any type with kp(), ki() and kd() can be used as
+* the gains policy, constexpr static ones give compile-time gains.
+*/
+template <typename T>
+struct RuntimeGains {
+  T Kp;
+  T Ki;
+  T Kd;
+
+  RuntimeGains() : Kp(0), Ki(0), Kd(0) {}
+
+  T kp() const { return Kp; }
+  T ki() const { return Ki; }
+  T kd() const { return Kd; }
+};
+
+/*
+* Derivative term used as is.
+*/
+struct RawDerivative {
+  template <typename T> T Filter(T d) { return d; }
+  void Reset() {}
+};
+
+/*
+* First order low-pass on the derivative term, y += (Num / Den) (d - y).
+*/
+template <typename T, int Num, int Den>
+struct LowPassDerivative {
+  static_assert(Num > 0 && Num <= Den, "smoothing factor must be in (0, 1]");
+
+  T state;
+
+  LowPassDerivative() : state(0) {}
+
+  T Filter(T d) {
+    state = state + T(static_cast<double>(Num) / Den) * (d - state);
+    return state;
+  }
+  void Reset() { state = T(0); }
+};
+
+/*
+* Integral accumulated without bound.
+*/
+struct NoAntiWindup {
+  template <typename T> T Integrate(T i, T e) { return i + e; }
+};
+
+/*
+* Integral clamped to [-Limit, Limit].
+*/
+template <typename T, int Limit>
+struct ClampIntegral {
+  T Integrate(T i, T e) {
+    i = i + e;
+    if (i > T(Limit)) return T(Limit);
+    if (i < T(-Limit)) return T(-Limit);
+    return i;
+  }
+};
+
+/*
+* Output passed through unchanged.
+*/
+struct NoOutputClamp {
+  template <typename T> T Clamp(T u) const { return u; }
+};
+
+/*
+* Output clamped to [Lo, Hi].
+*/
+template <typename T, int Lo, int Hi>
+struct ClampOutput {
+  static_assert(Lo < Hi, "empty output range");
+
+  T Clamp(T u) const {
+    if (u > T(Hi)) return T(Hi);
+    if (u < T(Lo)) return T(Lo);
+    return u;
+  }
+};
+
+/*
+* Bundle of the four policies used by BasicPID.
+*/
+template <class GainsT,
+          class DerivativeT = RawDerivative,
+          class AntiWindupT = NoAntiWindup,
+          class OutputT = NoOutputClamp>
+struct Policy {
+  typedef GainsT Gains;
+  typedef DerivativeT Derivative;
+  typedef AntiWindupT AntiWindup;
+  typedef OutputT Output;
+};
+
+} // namespace pid
+
+template <typename T, class Policy>
+class BasicPID : public Policy::Gains {
+public:
+  typedef T Scalar;
+
+  /*
+  * Errors
+  */
+  T p_error;
+  T i_error;
+  T d_error;
+
+  BasicPID() : p_error(0), i_error(0), d_error(0) {}
+
+  /*
+  * Clear the error terms and filter state, keeping the gains.
+  */
+  void Reset() {
+    p_error = T(0);
+    i_error = T(0);
+    d_error = T(0);
+    derivative_.Reset();
+  }
+
+  /*
+  * Update the error terms given cross track error.
+  */
+  void UpdateError(T cte) {
+    d_error = derivative_.Filter(cte - p_error);
+    p_error = cte;
+    i_error = anti_windup_.Integrate(i_error, cte);
+  }
+
+  /*
+  * Total control output. Evaluated in the same order as PID so double
+  * results match bit for bit.
+  */
+  T TotalError() const {
+    const T kp = T(this->kp());
+    const T ki = T(this->ki());
+    const T kd = T(this->kd());
+    return output_.Clamp(- kp * p_error - kd * d_error - ki * i_error);
+  }
+
+private:
+  typename Policy::Derivative derivative_;
+  typename Policy::AntiWindup anti_windup_;
+  typename Policy::Output output_;
+};
+
+#endif /* BASIC_PID_H */
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include "tuner.h"
+
+// Gaussian process Bayesian optimization on inputs scaled to [-1, 1],
+// the edges of the search box.
+
+namespace {
+
+const int n = Tuner::kGains;
+
+// Noise variance relative to the signal variance; the crash penalty makes
+// the error surface jump, so the fit is not asked to interpolate exactly.
+const double kNoise = 1e-2;
+const double kLengths[] = { 0.15, 0.25, 0.4, 0.6, 1.0 };
+const int kRandomCandidates = 1024;
+const int kLocalCandidates = 256;
+const double kLocalSpread = 0.05;
+
+double Kernel(const double *a, const double *b, double length) {
+  double d2 = 0;
+  for (int i = 0; i < n; ++i) d2 += (a[i] - b[i]) * (a[i] - b[i]);
+  return exp(-0.5 * d2 / (length * length));
+}
+
+double Clamp(double x, double lo, double hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+
+} // namespace
+
+const int BayesianTuner::kMaxObservations;
+
+BayesianTuner::BayesianTuner(const TunerOptions &options)
+    : Tuner(options.p, options.dp, options.tol, options.max_episodes),
+      batch_(std::max(1, options.batch)),
+      rng_(options.seed),
+      length_(kLengths[0]),
+      y_mean_(0),
+      y_scale_(1) {
+  for (int i = 0; i < n; ++i) {
+    lo_[i] = std::max(0.0, options.p[i] - options.range[i]);
+    hi_[i] = options.p[i] + options.range[i];
+  }
+}
+
+double BayesianTuner::step() const {
+  double sum = 0;
+  for (int i = 0; i < n; ++i) sum += 0.5 * (hi_[i] - lo_[i]);
+  return sum;
+}
+
+bool BayesianTuner::Converged() const {
+  return episodes() >= kMaxObservations;
+}
+
+void BayesianTuner::Propose(std::vector<Point> *batch) {
+
+  // Never ask past the episode budget; a cut-short start set is still
+  // learned from.
+  const int budget = std::min(max_episodes_, kMaxObservations) - episodes();
+  asked_.clear();
+  if (x_.empty()) {
+    // The starting point and a Latin hypercube around it.
+    const int m = 2 * n;
+    for (int i = 0; i < n; ++i) {
+      asked_.push_back(2 * (p0_[i] - lo_[i]) / (hi_[i] - lo_[i]) - 1);
+    }
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<double> design(m * n);
+    for (int i = 0; i < n; ++i) {
+      std::vector<int> strata(m);
+      for (int k = 0; k < m; ++k) strata[k] = k;
+      std::shuffle(strata.begin(), strata.end(), rng_);
+      for (int k = 0; k < m; ++k) {
+        design[k * n + i] = 2 * (strata[k] + unit(rng_)) / m - 1;
+      }
+    }
+    asked_.insert(asked_.end(), design.begin(), design.end());
+    if (static_cast<int>(asked_.size()) > budget * n) asked_.resize(budget * n);
+  } else {
+    // Kriging believer: each pick is added with its predicted mean as if
+    // observed, so the next pick of the batch goes elsewhere.
+    int q = std::min(batch_, budget);
+    std::vector<double> x = x_;
+    std::vector<double> y = y_;
+    std::vector<double> scratch;
+    std::uniform_real_distribution<double> uniform(-1, 1);
+    std::normal_distribution<double> local(0, kLocalSpread);
+    for (int pick = 0; pick < q; ++pick) {
+      Fit(x, y);
+      size_t best = std::min_element(y.begin(), y.end()) - y.begin();
+      double target = (y[best] - y_mean_) / y_scale_;
+      double best_ei = -1;
+      double chosen[n] = { 0, 0, 0 };
+      for (int c = 0; c < kRandomCandidates + kLocalCandidates; ++c) {
+        double z[n];
+        for (int i = 0; i < n; ++i) {
+          z[i] = c < kRandomCandidates
+                     ? uniform(rng_)
+                     : Clamp(x[best * n + i] + local(rng_), -1, 1);
+        }
+        double mean, sd;
+        Predict(x, z, &mean, &sd, &scratch);
+        double u = (target - mean) / sd;
+        double ei = (target - mean) * 0.5 * erfc(-u / sqrt(2.0)) +
+                    sd * exp(-0.5 * u * u) / sqrt(2 * M_PI);
+        if (ei > best_ei) {
+          best_ei = ei;
+          for (int i = 0; i < n; ++i) chosen[i] = z[i];
+        }
+      }
+      double mean, sd;
+      Predict(x, chosen, &mean, &sd, &scratch);
+      x.insert(x.end(), chosen, chosen + n);
+      y.push_back(mean * y_scale_ + y_mean_);
+      asked_.insert(asked_.end(), chosen, chosen + n);
+    }
+  }
+
+  for (size_t k = 0; k < asked_.size(); k += n) {
+    Point point;
+    for (int i = 0; i < n; ++i) {
+      point.p[i] = lo_[i] + 0.5 * (asked_[k + i] + 1) * (hi_[i] - lo_[i]);
+    }
+    batch->push_back(point);
+  }
+}
+
+void BayesianTuner::SaveState(State *state) const {
+
+  State &s = *state;
+  s["box"].assign(lo_, lo_ + n);
+  s["box"].insert(s["box"].end(), hi_, hi_ + n);
+  s["x"] = x_;
+  s["y"] = y_;
+  s["asked"] = asked_;
+  SaveRng(rng_, &s["rng"]);
+}
+
+bool BayesianTuner::LoadState(const State &state) {
+
+  double box[2 * n];
+  if (!Read(state, "box", 2 * n, box) || !state.count("x") ||
+      !state.count("y") || !state.count("asked") || !state.count("rng")) {
+    return false;
+  }
+  const std::vector<double> &x = state.at("x");
+  const std::vector<double> &y = state.at("y");
+  const std::vector<double> &asked = state.at("asked");
+  if (x.size() != y.size() * n || asked.size() % n != 0 ||
+      !LoadRng(state.at("rng"), &rng_)) {
+    return false;
+  }
+  for (int i = 0; i < n; ++i) {
+    lo_[i] = box[i];
+    hi_[i] = box[n + i];
+  }
+  x_ = x;
+  y_ = y;
+  asked_ = asked;
+  return true;
+}
+
+void BayesianTuner::Learn(const std::vector<double> &errors) {
+
+  for (size_t k = 0; k < errors.size(); ++k) {
+    x_.insert(x_.end(), &asked_[k * n], &asked_[k * n] + n);
+    y_.push_back(log(std::max(errors[k], 1e-12)));
+  }
+}
+
+void BayesianTuner::Fit(const std::vector<double> &x,
+                        const std::vector<double> &y) {
+
+  const size_t m = y.size();
+  double sum = 0;
+  for (double v : y) sum += v;
+  y_mean_ = sum / m;
+  double var = 0;
+  for (double v : y) var += (v - y_mean_) * (v - y_mean_);
+  y_scale_ = std::max(sqrt(var / m), 1e-9);
+
+  std::vector<double> target(m);
+  for (size_t i = 0; i < m; ++i) target[i] = (y[i] - y_mean_) / y_scale_;
+
+  // Length scale with the highest marginal likelihood.
+  double best_nll = std::numeric_limits<double>::infinity();
+  std::vector<double> chol;
+  std::vector<double> alpha(m);
+  for (double length : kLengths) {
+    double log_det = Factor(x, length, &chol);
+    // alpha = K^-1 y by two triangular solves.
+    for (size_t i = 0; i < m; ++i) {
+      double s = target[i];
+      for (size_t k = 0; k < i; ++k) s -= chol[i * m + k] * alpha[k];
+      alpha[i] = s / chol[i * m + i];
+    }
+    double fit = 0;
+    for (size_t i = 0; i < m; ++i) fit += alpha[i] * alpha[i];
+    for (size_t i = m; i-- > 0;) {
+      double s = alpha[i];
+      for (size_t k = i + 1; k < m; ++k) s -= chol[k * m + i] * alpha[k];
+      alpha[i] = s / chol[i * m + i];
+    }
+    double nll = 0.5 * fit + 0.5 * log_det;
+    if (nll < best_nll) {
+      best_nll = nll;
+      length_ = length;
+      chol_.swap(chol);
+      alpha_.swap(alpha);
+      alpha.resize(m);
+    }
+  }
+}
+
+double BayesianTuner::Factor(const std::vector<double> &x, double length,
+                             std::vector<double> *chol) const {
+
+  const size_t m = x.size() / n;
+  chol->assign(m * m, 0);
+  std::vector<double> &l = *chol;
+  double log_det = 0;
+  for (size_t i = 0; i < m; ++i) {
+    for (size_t j = 0; j <= i; ++j) {
+      double s = Kernel(&x[i * n], &x[j * n], length) + (i == j ? kNoise : 0);
+      for (size_t k = 0; k < j; ++k) s -= l[i * m + k] * l[j * m + k];
+      if (i == j) {
+        l[i * m + i] = sqrt(std::max(s, 1e-12));
+        log_det += 2 * log(l[i * m + i]);
+      } else {
+        l[i * m + j] = s / l[j * m + j];
+      }
+    }
+  }
+  return log_det;
+}
+
+void BayesianTuner::Predict(const std::vector<double> &x, const double *z,
+                            double *mean, double *sd,
+                            std::vector<double> *scratch) const {
+
+  const size_t m = x.size() / n;
+  scratch->resize(m);
+  std::vector<double> &v = *scratch;
+  double mu = 0;
+  for (size_t i = 0; i < m; ++i) {
+    v[i] = Kernel(&x[i * n], z, length_);
+    mu += v[i] * alpha_[i];
+  }
+  // Variance 1 - k' K^-1 k, with L v = k.
+  double explained = 0;
+  for (size_t i = 0; i < m; ++i) {
+    double s = v[i];
+    for (size_t k = 0; k < i; ++k) s -= chol_[i * m + k] * v[k];
+    v[i] = s / chol_[i * m + i];
+    explained += v[i] * v[i];
+  }
+  *mean = mu;
+  *sd = sqrt(std::max(1 - explained, 1e-12));
+}
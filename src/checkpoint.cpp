@@ -0,0 +1,121 @@
+#include "checkpoint.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <unistd.h>
+#include "logger.h"
+
+bool WriteFileAtomic(const std::string &path, const std::string &data,
+                     std::string *error) {
+
+  const std::string tmp = path + ".tmp";
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    *error = "cannot create " + tmp + ": " + strerror(errno);
+    return false;
+  }
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t n = write(fd, data.data() + done, data.size() - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) break;
+    done += n;
+  }
+  bool ok = done == data.size() && fsync(fd) == 0;
+  ok = close(fd) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    *error = "cannot write " + path + ": " + strerror(errno);
+    unlink(tmp.c_str());
+    return false;
+  }
+
+  // Make the rename itself durable.
+  size_t slash = path.rfind('/');
+  std::string dir =
+      slash == std::string::npos ? "." : path.substr(0, slash + 1);
+  int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  return true;
+}
+
+Checkpoint::Checkpoint()
+    : dirty_(false), owned_(false), stop_(false) {}
+
+Checkpoint::~Checkpoint() {
+  Close();
+}
+
+bool Checkpoint::Open(const std::string &path, bool resume,
+                      std::string *error) {
+  Close();
+  path_ = path;
+  latest_.clear();
+  if (resume) {
+    std::ifstream in(path);
+    if (!in) {
+      *error = "cannot open " + path;
+      return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    latest_ = buffer.str();
+  }
+  dirty_ = false;
+  stop_ = false;
+  writer_ = std::thread(&Checkpoint::WriterLoop, this);
+  return true;
+}
+
+void Checkpoint::Close() {
+  if (!writer_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+}
+
+bool Checkpoint::Claim(std::string *state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (owned_) return false;
+  owned_ = true;
+  *state = latest_;
+  return true;
+}
+
+void Checkpoint::Release() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  owned_ = false;
+}
+
+void Checkpoint::Save(std::string state) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest_.swap(state);
+    dirty_ = true;
+  }
+  wake_.notify_one();
+}
+
+void Checkpoint::WriterLoop() {
+  std::string state;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return dirty_ || stop_; });
+      if (!dirty_) return;
+      state = latest_;
+      dirty_ = false;
+    }
+    std::string error;
+    if (!WriteFileAtomic(path_, state, &error)) {
+      LOG_ERROR("Checkpoint not saved: %s", error.c_str());
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+* Replace the file at path with data so that a crash at any point leaves
+* either the old or the new contents: write a temporary next to it, fsync,
+* rename over path and fsync the directory.
+*/
+bool WriteFileAtomic(const std::string &path, const std::string &data,
+                     std::string *error);
+
+/*
+* Tuner state kept on disk across disconnects and restarts. One session at
+* a time owns it: it resumes from the latest saved text and hands every
+* new state to Save, which only queues it. A background thread writes the
+* newest queued state with WriteFileAtomic, so the control loop never waits
+* on the disk.
+*/
+class Checkpoint {
+public:
+  Checkpoint();
+  ~Checkpoint();
+
+  Checkpoint(const Checkpoint &) = delete;
+  Checkpoint &operator=(const Checkpoint &) = delete;
+
+  /*
+  * Start writing to path. With resume the state saved there by an earlier
+  * run is read first, and a missing file is an error.
+  */
+  bool Open(const std::string &path, bool resume, std::string *error);
+
+  /*
+  * Write the last queued state and stop the writer.
+  */
+  void Close();
+
+  /*
+  * Take ownership if nobody has it, with the state to resume from (empty
+  * to start fresh). Returns false if another session owns it.
+  */
+  bool Claim(std::string *state);
+  void Release();
+
+  /*
+  * Queue a new state; older ones not yet written are dropped.
+  */
+  void Save(std::string state);
+
+private:
+  void WriterLoop();
+
+  std::string path_;
+  std::string latest_;
+  bool dirty_;
+  bool owned_;
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread writer_;
+};
+
+#endif /* CHECKPOINT_H */
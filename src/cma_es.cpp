@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <math.h>
+#include "tuner.h"
+
+// CMA-ES on coordinates scaled by dp, following the defaults of Hansen's
+// tutorial ("The CMA Evolution Strategy: A Tutorial", 2016).
+
+namespace {
+
+const int n = Tuner::kGains;
+
+// Cyclic Jacobi rotations: a = v diag(w) v', with a symmetric.
+void Eigen(const double a[n][n], double v[n][n], double w[n]) {
+
+  double m[n][n];
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      m[i][j] = a[i][j];
+      v[i][j] = i == j ? 1 : 0;
+    }
+  }
+  for (int sweep = 0; sweep < 50; ++sweep) {
+    double off = 0;
+    for (int p = 0; p < n; ++p) {
+      for (int q = p + 1; q < n; ++q) off += m[p][q] * m[p][q];
+    }
+    if (off < 1e-30) break;
+    for (int p = 0; p < n; ++p) {
+      for (int q = p + 1; q < n; ++q) {
+        if (m[p][q] == 0) continue;
+        double theta = (m[q][q] - m[p][p]) / (2 * m[p][q]);
+        double t = (theta >= 0 ? 1 : -1) /
+                   (fabs(theta) + sqrt(theta * theta + 1));
+        double c = 1 / sqrt(t * t + 1);
+        double s = t * c;
+        for (int k = 0; k < n; ++k) {
+          double mkp = m[k][p];
+          double mkq = m[k][q];
+          m[k][p] = c * mkp - s * mkq;
+          m[k][q] = s * mkp + c * mkq;
+        }
+        for (int k = 0; k < n; ++k) {
+          double mpk = m[p][k];
+          double mqk = m[q][k];
+          m[p][k] = c * mpk - s * mqk;
+          m[q][k] = s * mpk + c * mqk;
+        }
+        for (int k = 0; k < n; ++k) {
+          double vkp = v[k][p];
+          double vkq = v[k][q];
+          v[k][p] = c * vkp - s * vkq;
+          v[k][q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+  for (int i = 0; i < n; ++i) w[i] = m[i][i];
+}
+
+} // namespace
+
+CmaEsTuner::CmaEsTuner(const TunerOptions &options)
+    : Tuner(options.p, options.dp, options.tol, options.max_episodes),
+      sigma_(1),
+      generation_(0),
+      rng_(options.seed) {
+
+  lambda_ = std::max(4 + static_cast<int>(3 * log(static_cast<double>(n))),
+                     options.batch);
+  mu_ = lambda_ / 2;
+  double sum = 0;
+  double sum_sq = 0;
+  for (int i = 0; i < mu_; ++i) {
+    double w = log(mu_ + 0.5) - log(i + 1.0);
+    weights_.push_back(w);
+    sum += w;
+  }
+  for (double &w : weights_) {
+    w /= sum;
+    sum_sq += w * w;
+  }
+  mu_eff_ = 1 / sum_sq;
+  c_sigma_ = (mu_eff_ + 2) / (n + mu_eff_ + 5);
+  d_sigma_ = 1 + 2 * std::max(0.0, sqrt((mu_eff_ - 1) / (n + 1)) - 1) +
+             c_sigma_;
+  c_c_ = (4 + mu_eff_ / n) / (n + 4 + 2 * mu_eff_ / n);
+  c_1_ = 2 / ((n + 1.3) * (n + 1.3) + mu_eff_);
+  c_mu_ = std::min(1 - c_1_, 2 * (mu_eff_ - 2 + 1 / mu_eff_) /
+                                 ((n + 2) * (n + 2) + mu_eff_));
+  chi_n_ = sqrt(static_cast<double>(n)) * (1 - 1.0 / (4 * n) +
+                                           1.0 / (21 * n * n));
+
+  for (int i = 0; i < n; ++i) {
+    mean_[i] = 0;
+    p_sigma_[i] = 0;
+    p_c_[i] = 0;
+    d_[i] = 1;
+    for (int j = 0; j < n; ++j) {
+      c_[i][j] = i == j ? 1 : 0;
+      b_[i][j] = i == j ? 1 : 0;
+    }
+  }
+  y_.resize(lambda_ * n);
+}
+
+double CmaEsTuner::step() const {
+
+  double sum = 0;
+  for (int i = 0; i < n; ++i) sum += sigma_ * sqrt(c_[i][i]) * dp_[i];
+  return sum;
+}
+
+void CmaEsTuner::SaveState(State *state) const {
+
+  State &s = *state;
+  s["mean"].assign(mean_, mean_ + n);
+  s["sigma"].assign(1, sigma_);
+  s["generation"].assign(1, generation_);
+  s["lambda"].assign(1, lambda_);
+  s["c"].assign(&c_[0][0], &c_[0][0] + n * n);
+  s["b"].assign(&b_[0][0], &b_[0][0] + n * n);
+  s["d"].assign(d_, d_ + n);
+  s["p_sigma"].assign(p_sigma_, p_sigma_ + n);
+  s["p_c"].assign(p_c_, p_c_ + n);
+  s["y"] = y_;
+  SaveRng(rng_, &s["rng"]);
+}
+
+bool CmaEsTuner::LoadState(const State &state) {
+
+  double generation, lambda;
+  if (!Read(state, "mean", n, mean_) || !Read(state, "sigma", 1, &sigma_) ||
+      !Read(state, "generation", 1, &generation) ||
+      !Read(state, "lambda", 1, &lambda) ||
+      !Read(state, "c", n * n, &c_[0][0]) ||
+      !Read(state, "b", n * n, &b_[0][0]) || !Read(state, "d", n, d_) ||
+      !Read(state, "p_sigma", n, p_sigma_) || !Read(state, "p_c", n, p_c_) ||
+      !Read(state, "y", y_.size(), y_.data()) ||
+      static_cast<int>(lambda) != lambda_ || !state.count("rng") ||
+      !LoadRng(state.at("rng"), &rng_)) {
+    return false;
+  }
+  generation_ = static_cast<int>(generation);
+  return true;
+}
+
+void CmaEsTuner::Propose(std::vector<Point> *batch) {
+
+  // The last generation is cut short to stay within the episode budget.
+  int count = std::min(lambda_, max_episodes_ - episodes());
+  std::normal_distribution<double> normal(0, 1);
+  for (int k = 0; k < count; ++k) {
+    double z[n];
+    for (int i = 0; i < n; ++i) z[i] = d_[i] * normal(rng_);
+    double x[n];
+    for (int i = 0; i < n; ++i) {
+      double y = 0;
+      for (int j = 0; j < n; ++j) y += b_[i][j] * z[j];
+      y_[k * n + i] = y;
+      x[i] = mean_[i] + sigma_ * y;
+    }
+    batch->push_back(ToGains(x));
+  }
+}
+
+void CmaEsTuner::Learn(const std::vector<double> &errors) {
+
+  // A cut short generation ends the search; Tell has kept its best point.
+  if (static_cast<int>(errors.size()) < lambda_) return;
+
+  std::vector<int> order(lambda_);
+  for (int k = 0; k < lambda_; ++k) order[k] = k;
+  std::sort(order.begin(), order.end(),
+            [&errors](int a, int b) { return errors[a] < errors[b]; });
+
+  // Weighted mean of the best mu steps.
+  double y_w[n] = { 0, 0, 0 };
+  for (int k = 0; k < mu_; ++k) {
+    for (int i = 0; i < n; ++i) y_w[i] += weights_[k] * y_[order[k] * n + i];
+  }
+  for (int i = 0; i < n; ++i) mean_[i] += sigma_ * y_w[i];
+
+  // C^-1/2 y_w = B D^-1 B' y_w
+  double bty[n];
+  for (int j = 0; j < n; ++j) {
+    bty[j] = 0;
+    for (int i = 0; i < n; ++i) bty[j] += b_[i][j] * y_w[i];
+    bty[j] /= d_[j];
+  }
+  double norm = 0;
+  double cs = sqrt(c_sigma_ * (2 - c_sigma_) * mu_eff_);
+  for (int i = 0; i < n; ++i) {
+    double w = 0;
+    for (int j = 0; j < n; ++j) w += b_[i][j] * bty[j];
+    p_sigma_[i] = (1 - c_sigma_) * p_sigma_[i] + cs * w;
+    norm += p_sigma_[i] * p_sigma_[i];
+  }
+  norm = sqrt(norm);
+  ++generation_;
+  double decay = 1 - pow(1 - c_sigma_, 2.0 * generation_);
+  bool h_sigma = norm / sqrt(decay) < (1.4 + 2.0 / (n + 1)) * chi_n_;
+
+  double cc = sqrt(c_c_ * (2 - c_c_) * mu_eff_);
+  for (int i = 0; i < n; ++i) {
+    p_c_[i] = (1 - c_c_) * p_c_[i] + (h_sigma ? cc * y_w[i] : 0);
+  }
+  double lost = h_sigma ? 0 : c_c_ * (2 - c_c_);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      double rank_mu = 0;
+      for (int k = 0; k < mu_; ++k) {
+        const double *y = &y_[order[k] * n];
+        rank_mu += weights_[k] * y[i] * y[j];
+      }
+      c_[i][j] = (1 - c_1_ - c_mu_) * c_[i][j] +
+                 c_1_ * (p_c_[i] * p_c_[j] + lost * c_[i][j]) +
+                 c_mu_ * rank_mu;
+    }
+  }
+  sigma_ *= exp(c_sigma_ / d_sigma_ * (norm / chi_n_ - 1));
+
+  double w[n];
+  Eigen(c_, b_, w);
+  for (int i = 0; i < n; ++i) d_[i] = sqrt(std::max(w[i], 1e-20));
+}
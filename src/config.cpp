@@ -0,0 +1,371 @@
+#include "config.h"
+#include <fstream>
+#include <math.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "json.hpp"
+#include "logger.h"
+
+// for convenience
+using json = nlohmann::json;
+
+namespace {
+
+// How often the watcher wakes up to check for shutdown and to reclaim.
+const int kPollMs = 200;
+
+// Longest tuning episode accepted, about 14 hours at 20 frames a second.
+const int kMaxTwiddleSteps = 1000000;
+
+bool ReadFile(const std::string &path, std::string *text, std::string *error) {
+  std::ifstream in(path);
+  if (!in) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  *text = buffer.str();
+  return true;
+}
+
+bool ReadTriple(const json &j, const char *key, double out[3],
+                std::string *error) {
+  if (!j.count(key)) return true;
+  const json &v = j[key];
+  if (!v.is_array() || v.size() != 3 || !v[0].is_number() ||
+      !v[1].is_number() || !v[2].is_number()) {
+    *error = std::string("\"") + key + "\" must be [Kp, Ki, Kd]";
+    return false;
+  }
+  for (int i = 0; i < 3; ++i) out[i] = v[i].get<double>();
+  return true;
+}
+
+bool ReadNumber(const json &j, const char *key, double *out,
+                std::string *error) {
+  if (!j.count(key)) return true;
+  if (!j[key].is_number()) {
+    *error = std::string("\"") + key + "\" must be a number";
+    return false;
+  }
+  *out = j[key].get<double>();
+  return true;
+}
+
+} // namespace
+
+ControllerConfig::ControllerConfig()
+    : port(4567),
+      twiddle_enabled(false),
+      twiddle_tuner(TunerKind::kTwiddle),
+      twiddle_tol(0.0002),
+      twiddle_steps(1000),
+      twiddle_crash_cte(4),
+      version(0) {
+  Controller defaults;
+  const PID &s = defaults.pid_steer;
+  const PID &p = defaults.pid_speed;
+  steer_gains[0] = s.Kp;
+  steer_gains[1] = s.Ki;
+  steer_gains[2] = s.Kd;
+  speed_gains[0] = p.Kp;
+  speed_gains[1] = p.Ki;
+  speed_gains[2] = p.Kd;
+  target_speed = defaults.target_speed;
+  corner_slowdown = defaults.corner_slowdown;
+  steer_shape = defaults.steer_shape;
+  steer_mode = defaults.steer_mode;
+  frame_period = Controller::kFramePeriod;
+  steer_derivative_tau = Controller::kSteerDerivativeTau;
+  //double twiddle_p[] = { 0.0002, 0.00001, 0.0001 };
+  //Delta: 0.00473514 , 0.000864536 , 0.00707348
+  twiddle_dp[0] = 0.01;
+  twiddle_dp[1] = 0.001;
+  twiddle_dp[2] = 0.01;
+}
+
+bool ControllerConfig::Parse(const std::string &text, std::string *error) {
+
+  json j;
+  try {
+    j = json::parse(text);
+  } catch (const std::exception &e) {
+    *error = e.what();
+    return false;
+  }
+  if (!j.is_object()) {
+    *error = "configuration must be a JSON object";
+    return false;
+  }
+
+  ControllerConfig c = *this;
+  double port_value = c.port;
+  if (!ReadNumber(j, "port", &port_value, error) ||
+      !ReadTriple(j, "steer_gains", c.steer_gains, error) ||
+      !ReadTriple(j, "speed_gains", c.speed_gains, error) ||
+      !ReadNumber(j, "target_speed", &c.target_speed, error) ||
+      !ReadNumber(j, "corner_slowdown", &c.corner_slowdown, error) ||
+      !ReadNumber(j, "frame_period", &c.frame_period, error) ||
+      !ReadNumber(j, "steer_derivative_tau", &c.steer_derivative_tau, error)) {
+    return false;
+  }
+  if (port_value < 1 || port_value > 65535 || port_value != floor(port_value)) {
+    *error = "\"port\" must be an integer from 1 to 65535";
+    return false;
+  }
+  c.port = static_cast<int>(port_value);
+  if (!(c.frame_period > 0) || !(c.steer_derivative_tau >= 0)) {
+    *error = "\"frame_period\" must be positive and "
+             "\"steer_derivative_tau\" not negative";
+    return false;
+  }
+
+  if (j.count("steer_shape")) {
+    if (!j["steer_shape"].is_string() ||
+        !ParseSteerShape(j["steer_shape"].get<std::string>().c_str(),
+                         &c.steer_shape)) {
+      *error = "unknown \"steer_shape\"";
+      return false;
+    }
+  }
+
+  if (j.count("steer_mode")) {
+    if (!j["steer_mode"].is_string() ||
+        !ParseSteerMode(j["steer_mode"].get<std::string>().c_str(),
+                        &c.steer_mode)) {
+      *error = "unknown \"steer_mode\"";
+      return false;
+    }
+  }
+
+  if (j.count("steer_schedule")) {
+    const json &s = j["steer_schedule"];
+    std::shared_ptr<GainSchedule> schedule;
+    std::string schedule_error;
+    bool ok = true;
+    if (!s.is_null()) {
+      schedule = std::make_shared<GainSchedule>();
+      ok = s.is_string()
+               ? schedule->Load(s.get<std::string>(), &schedule_error)
+               : schedule->Parse(s.dump(), &schedule_error);
+    }
+    if (!ok) {
+      *error = "\"steer_schedule\": " + schedule_error;
+      return false;
+    }
+    c.steer_schedule = schedule;
+  }
+
+  if (j.count("twiddle")) {
+    const json &t = j["twiddle"];
+    double steps = c.twiddle_steps;
+    if (!t.is_object() ||
+        (t.count("enabled") && !t["enabled"].is_boolean())) {
+      *error = "bad \"twiddle\" settings";
+      return false;
+    }
+    if (t.count("tuner") &&
+        (!t["tuner"].is_string() ||
+         !ParseTunerKind(t["tuner"].get<std::string>().c_str(),
+                         &c.twiddle_tuner))) {
+      *error = "unknown \"twiddle\" \"tuner\"";
+      return false;
+    }
+    if (!ReadTriple(t, "dp", c.twiddle_dp, error) ||
+        !ReadNumber(t, "tol", &c.twiddle_tol, error) ||
+        !ReadNumber(t, "steps", &steps, error) ||
+        !ReadNumber(t, "crash_cte", &c.twiddle_crash_cte, error)) {
+      return false;
+    }
+    if (steps < 1 || steps > kMaxTwiddleSteps || steps != floor(steps)) {
+      *error = "\"twiddle\" \"steps\" must be an integer from 1 to " +
+               std::to_string(kMaxTwiddleSteps);
+      return false;
+    }
+    if (!(c.twiddle_tol > 0) || !(c.twiddle_crash_cte > 0)) {
+      *error = "\"twiddle\" \"tol\" and \"crash_cte\" must be positive";
+      return false;
+    }
+    if (t.count("enabled")) c.twiddle_enabled = t["enabled"].get<bool>();
+    c.twiddle_steps = static_cast<int>(steps);
+  }
+
+  *this = c;
+  return true;
+}
+
+void ControllerConfig::ApplyTo(Controller *controller,
+                               bool keep_steer_gains) const {
+
+  controller->pid_speed.Kp = speed_gains[0];
+  controller->pid_speed.Ki = speed_gains[1];
+  controller->pid_speed.Kd = speed_gains[2];
+  controller->target_speed = target_speed;
+  controller->corner_slowdown = corner_slowdown;
+  controller->steer_shape = steer_shape;
+  controller->SetTiming(frame_period, steer_derivative_tau);
+  // A schedule or MPC would override the gains being kept.
+  if (keep_steer_gains) return;
+  controller->pid_steer.Kp = steer_gains[0];
+  controller->pid_steer.Ki = steer_gains[1];
+  controller->pid_steer.Kd = steer_gains[2];
+  // Shares the parsed table, so a reload never copies it here.
+  controller->steer_schedule = steer_schedule;
+  if (controller->steer_mode != steer_mode) {
+    PID &pid = controller->pid_steer;
+    pid.Init(pid.Kp, pid.Ki, pid.Kd);
+    controller->mpc_steer.Reset();
+    controller->steer_mode = steer_mode;
+  }
+}
+
+bool LoadConfig(const std::string &path, const std::string &overrides,
+                ControllerConfig *config, std::string *error) {
+
+  ControllerConfig c;
+  if (!path.empty()) {
+    std::string text;
+    if (!ReadFile(path, &text, error)) return false;
+    if (!c.Parse(text, error)) {
+      *error = path + ": " + *error;
+      return false;
+    }
+  }
+  if (!overrides.empty() && !c.Parse(overrides, error)) {
+    *error = "command line: " + *error;
+    return false;
+  }
+  *config = c;
+  return true;
+}
+
+ConfigStore::ConfigStore(const ControllerConfig &initial)
+    : current_(new ControllerConfig(initial)), epoch_(1), version_(0) {}
+
+ConfigStore::~ConfigStore() {
+  delete current_.load();
+  for (const Retired &r : retired_) delete r.config;
+}
+
+void ConfigStore::Publish(std::unique_ptr<ControllerConfig> config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t version = version_.load() + 1;
+  config->version = version;
+  ControllerConfig *old = current_.exchange(config.release());
+  // A reader that pins after this increment is guaranteed to load the new
+  // pointer; one that pinned before shows an older epoch until it unpins.
+  uint64_t epoch = epoch_.fetch_add(1) + 1;
+  retired_.push_back(Retired { old, epoch });
+  version_.store(version, std::memory_order_release);
+}
+
+void ConfigStore::Reclaim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t kept = 0;
+  for (const Retired &r : retired_) {
+    bool in_use = false;
+    for (const Reader *reader : readers_) {
+      uint64_t e = reader->epoch_.load();
+      if (e != 0 && e < r.epoch) in_use = true;
+    }
+    if (in_use) {
+      retired_[kept++] = r;
+    } else {
+      delete r.config;
+    }
+  }
+  retired_.resize(kept);
+}
+
+ConfigStore::Reader::Reader(ConfigStore *store) : store_(store), epoch_(0) {
+  std::lock_guard<std::mutex> lock(store_->mutex_);
+  store_->readers_.push_back(this);
+}
+
+ConfigStore::Reader::~Reader() {
+  std::lock_guard<std::mutex> lock(store_->mutex_);
+  std::vector<Reader *> &readers = store_->readers_;
+  for (size_t i = 0; i < readers.size(); ++i) {
+    if (readers[i] == this) {
+      readers[i] = readers.back();
+      readers.pop_back();
+      break;
+    }
+  }
+}
+
+const ControllerConfig *ConfigStore::Reader::Pin() {
+  epoch_.store(store_->epoch_.load());
+  return store_->current_.load();
+}
+
+ConfigWatcher::ConfigWatcher() : store_(nullptr), fd_(-1), stop_(false) {}
+
+ConfigWatcher::~ConfigWatcher() {
+  Stop();
+}
+
+bool ConfigWatcher::Start(const std::string &path, const std::string &overrides,
+                          ConfigStore *store, std::string *error) {
+  Stop();
+  size_t slash = path.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+  path_ = path;
+  name_ = slash == std::string::npos ? path : path.substr(slash + 1);
+  overrides_ = overrides;
+  store_ = store;
+
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd_ < 0 ||
+      inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    *error = "cannot watch " + dir;
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  stop_ = false;
+  thread_ = std::thread(&ConfigWatcher::Loop, this);
+  return true;
+}
+
+void ConfigWatcher::Stop() {
+  if (fd_ < 0) return;
+  stop_ = true;
+  thread_.join();
+  close(fd_);
+  fd_ = -1;
+}
+
+void ConfigWatcher::Loop() {
+  alignas(inotify_event) char buffer[4096];
+  while (!stop_) {
+    struct pollfd pfd = { fd_, POLLIN, 0 };
+    if (poll(&pfd, 1, kPollMs) > 0) {
+      bool changed = false;
+      ssize_t n;
+      while ((n = read(fd_, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + n;) {
+          const inotify_event *event = reinterpret_cast<inotify_event *>(p);
+          if (event->len && name_ == event->name) changed = true;
+          p += sizeof(inotify_event) + event->len;
+        }
+      }
+      if (changed) Reload();
+    }
+    store_->Reclaim();
+  }
+}
+
+void ConfigWatcher::Reload() {
+  std::unique_ptr<ControllerConfig> config(new ControllerConfig());
+  std::string error;
+  if (!LoadConfig(path_, overrides_, config.get(), &error)) {
+    LOG_ERROR("Config not reloaded: %s", error.c_str());
+    return;
+  }
+  store_->Publish(std::move(config));
+  LOG_INFO("Config reloaded from %s", path_.c_str());
+}
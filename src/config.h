@@ -0,0 +1,180 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "controller.h"
+#include "tuner.h"
+
+/*
+* Tunable parameters of the server. Defaults match Controller and the
+* original Twiddle settings. JSON keys, all optional:
+*
+*   port             listening port from 1 to 65535, read at startup only
+*   steer_gains      [Kp, Ki, Kd]
+*   speed_gains      [Kp, Ki, Kd]
+*   target_speed     mph
+*   corner_slowdown  mph per degree of smoothed steering angle
+*   steer_shape      "sigmoid", "clamp", "rational" or "poly"
+*   steer_mode       "pid" or "mpc"
+*   steer_schedule   GainSchedule object, the path of a file holding one, or
+*                    null for none
+*   frame_period     seconds per frame the gains are tuned at, positive
+*   steer_derivative_tau
+*                    seconds, steering derivative filter of the timed
+*                    update, 0 for none
+*   twiddle          { "enabled": bool, "tuner": "twiddle", "nelder-mead",
+*                      "cma-es" or "bayes", "dp": [dKp, dKi, dKd], "tol": T,
+*                      "steps": N, "crash_cte": meters }, used by sessions
+*                      started afterwards; ignored with steer_mode "mpc"
+*                      or a steer_schedule. tol and crash_cte must be
+*                      positive and steps from 1 to a million.
+*/
+struct ControllerConfig {
+  int port;
+  double steer_gains[3];
+  double speed_gains[3];
+  double target_speed;
+  double corner_slowdown;
+  SteerShape steer_shape;
+  SteerMode steer_mode;
+  std::shared_ptr<const GainSchedule> steer_schedule;   // null for none
+  double frame_period;
+  double steer_derivative_tau;
+
+  bool twiddle_enabled;
+  TunerKind twiddle_tuner;
+  double twiddle_dp[3];
+  double twiddle_tol;
+  int twiddle_steps;
+  double twiddle_crash_cte;   // |cte| that ends an episode as a crash
+
+  uint64_t version;   // set by ConfigStore::Publish
+
+  ControllerConfig();
+
+  /*
+  * Apply the keys present in the JSON text on top of the current values.
+  * On error nothing is changed.
+  */
+  bool Parse(const std::string &text, std::string *error);
+
+  /*
+  * Copy the control law parameters into a running controller without
+  * clearing its error terms, except that switching the steering mode
+  * starts the new steering controller from a clean state. When
+  * keep_steer_gains is set, e.g. while a tuner owns the steering gains,
+  * the gains, schedule and steering mode are all left alone.
+  */
+  void ApplyTo(Controller *controller, bool keep_steer_gains) const;
+};
+
+/*
+* Defaults, then the file (unless path is empty), then the overrides given
+* as JSON text, typically built from command line flags.
+*/
+bool LoadConfig(const std::string &path, const std::string &overrides,
+                ControllerConfig *config, std::string *error);
+
+/*
+* Current configuration behind an atomic pointer, RCU style. Readers pin the
+* pointer with two atomic stores and never lock or wait; Publish swaps in a
+* new version, and the old one is freed once every reader pinned before the
+* swap has unpinned.
+*/
+class ConfigStore {
+public:
+  explicit ConfigStore(const ControllerConfig &initial);
+  ~ConfigStore();
+
+  ConfigStore(const ConfigStore &) = delete;
+  ConfigStore &operator=(const ConfigStore &) = delete;
+
+  /*
+  * Version of the current configuration, cheap enough to poll every tick.
+  */
+  uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+  /*
+  * Make config current. Called by the watcher or at startup, never from
+  * the control loop.
+  */
+  void Publish(std::unique_ptr<ControllerConfig> config);
+
+  /*
+  * Free replaced configurations that no reader can still see.
+  */
+  void Reclaim();
+
+  /*
+  * Per-session handle, registered for its lifetime. Pin returns the
+  * current configuration, valid until Unpin.
+  */
+  class Reader {
+  public:
+    explicit Reader(ConfigStore *store);
+    ~Reader();
+
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+
+    const ControllerConfig *Pin();
+    void Unpin() { epoch_.store(0, std::memory_order_release); }
+
+  private:
+    friend class ConfigStore;
+
+    ConfigStore *store_;
+    std::atomic<uint64_t> epoch_;   // epoch seen when pinned, 0 if not
+  };
+
+private:
+  struct Retired {
+    ControllerConfig *config;
+    uint64_t epoch;
+  };
+
+  std::atomic<ControllerConfig *> current_;
+  std::atomic<uint64_t> epoch_;
+  std::atomic<uint64_t> version_;
+
+  // Writer side only: registration, publishing and reclamation.
+  std::mutex mutex_;
+  std::vector<Reader *> readers_;
+  std::vector<Retired> retired_;
+};
+
+/*
+* Reloads the configuration whenever the file is written or replaced, using
+* inotify on its directory so editors that save through a rename are seen
+* too. A file that fails to parse is reported and the running
+* configuration is kept.
+*/
+class ConfigWatcher {
+public:
+  ConfigWatcher();
+  ~ConfigWatcher();
+
+  bool Start(const std::string &path, const std::string &overrides,
+             ConfigStore *store, std::string *error);
+  void Stop();
+
+private:
+  void Loop();
+  void Reload();
+
+  std::string path_;
+  std::string name_;
+  std::string overrides_;
+  ConfigStore *store_;
+  int fd_;
+  std::atomic<bool> stop_;
+  std::thread thread_;
+};
+
+#endif /* CONFIG_H */
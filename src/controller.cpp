@@ -0,0 +1,137 @@
+#include "controller.h"
+#include <math.h>
+#include <string.h>
+
+constexpr double Controller::kFramePeriod;
+constexpr double Controller::kSteerDerivativeTau;
+constexpr double Controller::kTargetSpeed;
+constexpr double Controller::kThrottleBias;
+constexpr double Controller::kSpeedTrackingGain;
+
+Controller::Controller()
+    : steer_shape(SteerShape::kSigmoid),
+      steer_mode(SteerMode::kPID),
+      target_speed(kTargetSpeed),
+      corner_slowdown(0),
+      frame_period_(kFramePeriod) {
+
+  pid_steer.Init(0.212221, 0.00974437, 3.01065);
+  pid_speed.Init(0.006, 0.00001, 0.0001);
+  SetTiming(kFramePeriod, kSteerDerivativeTau);
+  // The throttle saturates while the car is held back, e.g. after a crash.
+  pid_speed.SetAntiWindup(AntiWindup::kBackCalculation, 0,
+                          kSpeedTrackingGain);
+}
+
+Command Controller::Update(double cte, double speed, double angle) {
+
+  if (steer_mode == SteerMode::kMPC) {
+    mpc_steer.Update(cte, speed, frame_period_);
+  } else {
+    pid_steer.UpdateError(cte);
+  }
+  pid_speed.UpdateError(SpeedError(speed, angle));
+  ScheduleGains(speed);
+  return Output();
+}
+
+Command Controller::Update(double cte, double speed, double angle,
+                           double dt) {
+
+  if (steer_mode == SteerMode::kMPC) {
+    mpc_steer.Update(cte, speed, dt);
+  } else {
+    pid_steer.UpdateError(cte, dt);
+  }
+  pid_speed.UpdateError(SpeedError(speed, angle), dt);
+  ScheduleGains(speed);
+  return Output();
+}
+
+void Controller::SetTiming(double frame_period, double steer_derivative_tau) {
+
+  frame_period_ = frame_period;
+  pid_steer.SetTiming(frame_period, steer_derivative_tau);
+  pid_speed.SetTiming(frame_period, 0);
+}
+
+double Controller::SpeedError(double speed, double angle) {
+
+  // smooth out the angle
+  angle_filter_.Push(angle);
+  double avg_angle = angle_filter_.Value();
+
+  // Target speed, e.g. 90 - fabs(avg_angle) * 10
+  double target = target_speed;
+  if (corner_slowdown != 0) target -= corner_slowdown * fabs(avg_angle);
+
+  // DEBUG
+  //std::cout << " Angle: " << avg_angle
+  //          << " Taget: " << target
+  //          << " Speed: " << speed
+  //          << std::endl;
+
+  return speed - target;
+}
+
+void Controller::ScheduleGains(double speed) {
+
+  if (!steer_schedule || steer_mode == SteerMode::kMPC) return;
+  GainSchedule::Gains g =
+      steer_schedule->Lookup(speed, fabs(angle_filter_.Value()));
+  pid_steer.Kp = g.kp;
+  pid_steer.Ki = g.ki;
+  pid_steer.Kd = g.kd;
+}
+
+Command Controller::Output() {
+
+  Command cmd;
+
+  // Steer
+  double steer_value = 0;
+  if (steer_mode == SteerMode::kMPC) {
+    cmd.steering_angle = mpc_steer.steering();
+  } else {
+    steer_value = pid_steer.TotalError();
+    // limit the value between 1 and -1, by default with the sigmoid
+    // 2 / (1 + exp(-steer_value)) - 1
+    cmd.steering_angle = ShapeSteer(steer_shape, steer_value);
+  }
+
+  // Speed, limited to the range the simulator accepts
+  double throttle = Throttle(pid_speed.TotalError(), &cmd.throttle);
+
+  // Let the integrators see what was actually applied. Only the hard clamp
+  // saturates the steering; the smooth shapes never reach +-1.
+  if (steer_mode == SteerMode::kPID) {
+    pid_steer.Feedback(steer_value, steer_shape == SteerShape::kClamp
+                                        ? cmd.steering_angle : steer_value);
+  }
+  pid_speed.Feedback(throttle, cmd.throttle);
+
+  return cmd;
+}
+
+void Controller::Reset() {
+
+  pid_steer.Init(pid_steer.Kp, pid_steer.Ki, pid_steer.Kd);
+  pid_speed.Init(pid_speed.Kp, pid_speed.Ki, pid_speed.Kd);
+  mpc_steer.Reset();
+  angle_filter_.Clear();
+}
+
+const char *SteerModeName(SteerMode mode) {
+  return mode == SteerMode::kMPC ? "mpc" : "pid";
+}
+
+bool ParseSteerMode(const char *name, SteerMode *mode) {
+  if (!strcmp(name, "pid")) {
+    *mode = SteerMode::kPID;
+  } else if (!strcmp(name, "mpc")) {
+    *mode = SteerMode::kMPC;
+  } else {
+    return false;
+  }
+  return true;
+}
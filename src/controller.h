@@ -0,0 +1,137 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <memory>
+#include "PID.h"
+#include "gain_schedule.h"
+#include "mpc.h"
+#include "output_shaping.h"
+#include "rolling_window.h"
+
+/*
+* Actuator command sent back to the simulator.
+*/
+struct Command {
+  double steering_angle;
+  double throttle;
+};
+
+/*
+* Steering law: the PID through the steering shape, or model predictive
+* control (see mpc.h).
+*/
+enum class SteerMode {
+  kPID,
+  kMPC
+};
+
+const char *SteerModeName(SteerMode mode);
+bool ParseSteerMode(const char *name, SteerMode *mode);
+
+/*
+* Steering and throttle control law. The websocket server and the offline
+* simulator both drive the car through this class.
+*/
+class Controller {
+public:
+  /*
+  * Steering and speed controllers, public so the tuner can adjust gains.
+  */
+  PID pid_steer;
+  PID pid_speed;
+
+  /*
+  * Shape bounding the steering output, kSigmoid by default.
+  */
+  SteerShape steer_shape;
+
+  /*
+  * kPID by default. With kMPC, mpc_steer replaces pid_steer, steer_shape
+  * and steer_schedule; the speed law is the same.
+  */
+  SteerMode steer_mode;
+  MpcSteer mpc_steer;
+
+  /*
+  * Speed target in mph, lowered by corner_slowdown mph per degree of the
+  * smoothed steering angle. Defaults to kTargetSpeed and 0.
+  */
+  double target_speed;
+  double corner_slowdown;
+
+  /*
+  * When set, the steering gains are looked up every frame from the
+  * measured speed and the smoothed absolute steering angle, replacing
+  * pid_steer's Kp, Ki and Kd. The table is immutable and shared, so
+  * copies of the controller and of the configuration point at one copy.
+  */
+  std::shared_ptr<const GainSchedule> steer_schedule;
+
+  /*
+  * Constructor, initializes both controllers with the tuned gains.
+  */
+  Controller();
+
+  /*
+  * Compute the command for one telemetry frame.
+  */
+  Command Update(double cte, double speed, double angle);
+
+  /*
+  * Same, with the seconds elapsed since the previous frame measured on a
+  * monotonic clock, 0 when unknown. See PID::UpdateError(cte, dt).
+  */
+  Command Update(double cte, double speed, double angle, double dt);
+
+  /*
+  * Clear the error terms, MPC state and angle history, keeping the gains.
+  */
+  void Reset();
+
+  /*
+  * Frame period the gains were tuned at and time constant of the steering
+  * derivative filter used by the timed update, both in seconds; the speed
+  * derivative is never filtered. Without the filter a frame arriving early
+  * divides the cte noise by its fraction of a period, so the derivative
+  * term is up to 10 times louder than on a per-frame update.
+  */
+  void SetTiming(double frame_period, double steer_derivative_tau);
+  double frame_period() const { return frame_period_; }
+
+  /*
+  * Timing defaults. The filter costs a little agreement with the per-frame
+  * update on frames that arrive on time, and on the built-in track with
+  * 0.05 m of cte noise it lowers the CTE RMS at any frame jitter.
+  */
+  static constexpr double kFramePeriod = 0.05;
+  static constexpr double kSteerDerivativeTau = 0.1;
+
+  /*
+  * Speed law: target in mph, throttle bias added to the speed PID output,
+  * and back-calculation gain of the speed integral.
+  */
+  static constexpr double kTargetSpeed = 50;
+  static constexpr double kThrottleBias = 0.5;
+  static constexpr double kSpeedTrackingGain = 0.5;
+
+  /*
+  * Throttle the speed law demands for speed PID output u, kThrottleBias + u,
+  * with the command sent, limited to the [-1, 1] the simulator accepts,
+  * stored in applied. FleetSim steps cars with the same law.
+  */
+  static double Throttle(double u, double *applied) {
+    double throttle = kThrottleBias + u;
+    *applied = throttle > 1 ? 1 : (throttle < -1 ? -1 : throttle);
+    return throttle;
+  }
+
+private:
+  double frame_period_;
+  RollingMean<10> angle_filter_;
+
+  double SpeedError(double speed, double angle);
+  void ScheduleGains(double speed);
+  Command Output();
+};
+
+#endif /* CONTROLLER_H */
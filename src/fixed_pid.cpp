@@ -0,0 +1,92 @@
+#include "fixed_pid.h"
+
+namespace {
+
+// tanh(x / 2) in Q16.16 at x = -16 + i / 16.
+const int32_t kSquashTable[] = {
+  -65536, -65536, -65536, -65536, -65536, -65536, -65536, -65536,
+  -65536, -65536, -65536, -65536, -65536, -65536, -65536, -65536,
+  -65536, -65536, -65536, -65536, -65536, -65536, -65536, -65536,
+  -65536, -65536, -65536, -65536, -65536, -65536, -65536, -65536,
+  -65536, -65536, -65536, -65536, -65536, -65536, -65536, -65536,
+  -65536, -65536, -65536, -65536, -65536, -65536, -65536, -65536,
+  -65536, -65536, -65536, -65536, -65536, -65536, -65536, -65536,
+  -65536, -65535, -65535, -65535, -65535, -65535, -65535, -65535,
+  -65535, -65535, -65535, -65535, -65535, -65535, -65535, -65535,
+  -65535, -65535, -65534, -65534, -65534, -65534, -65534, -65534,
+  -65534, -65534, -65534, -65533, -65533, -65533, -65533, -65533,
+  -65532, -65532, -65532, -65532, -65531, -65531, -65531, -65530,
+  -65530, -65530, -65529, -65529, -65528, -65528, -65527, -65527,
+  -65526, -65526, -65525, -65524, -65523, -65523, -65522, -65521,
+  -65520, -65519, -65518, -65516, -65515, -65514, -65512, -65511,
+  -65509, -65508, -65506, -65504, -65502, -65500, -65497, -65495,
+  -65492, -65489, -65486, -65483, -65480, -65476, -65472, -65468,
+  -65464, -65459, -65454, -65449, -65443, -65437, -65431, -65424,
+  -65417, -65409, -65401, -65392, -65383, -65373, -65362, -65351,
+  -65339, -65327, -65313, -65299, -65283, -65267, -65250, -65231,
+  -65212, -65191, -65169, -65145, -65120, -65093, -65065, -65035,
+  -65003, -64968, -64932, -64893, -64852, -64808, -64761, -64712,
+  -64659, -64603, -64543, -64479, -64412, -64340, -64263, -64182,
+  -64096, -64004, -63907, -63803, -63693, -63576, -63451, -63319,
+  -63179, -63029, -62871, -62703, -62524, -62335, -62134, -61920,
+  -61694, -61454, -61199, -60929, -60643, -60340, -60019, -59680,
+  -59320, -58939, -58536, -58110, -57660, -57185, -56683, -56152,
+  -55593, -55003, -54382, -53727, -53038, -52314, -51552, -50752,
+  -49912, -49031, -48108, -47142, -46131, -45075, -43972, -42823,
+  -41625, -40379, -39084, -37740, -36346, -34904, -33412, -31873,
+  -30285, -28652, -26973, -25250, -23485, -21681, -19838, -17961,
+  -16051, -14112, -12146, -10157,  -8150,  -6126,  -4091,  -2047,
+       0,   2047,   4091,   6126,   8150,  10157,  12146,  14112,
+   16051,  17961,  19838,  21681,  23485,  25250,  26973,  28652,
+   30285,  31873,  33412,  34904,  36346,  37740,  39084,  40379,
+   41625,  42823,  43972,  45075,  46131,  47142,  48108,  49031,
+   49912,  50752,  51552,  52314,  53038,  53727,  54382,  55003,
+   55593,  56152,  56683,  57185,  57660,  58110,  58536,  58939,
+   59320,  59680,  60019,  60340,  60643,  60929,  61199,  61454,
+   61694,  61920,  62134,  62335,  62524,  62703,  62871,  63029,
+   63179,  63319,  63451,  63576,  63693,  63803,  63907,  64004,
+   64096,  64182,  64263,  64340,  64412,  64479,  64543,  64603,
+   64659,  64712,  64761,  64808,  64852,  64893,  64932,  64968,
+   65003,  65035,  65065,  65093,  65120,  65145,  65169,  65191,
+   65212,  65231,  65250,  65267,  65283,  65299,  65313,  65327,
+   65339,  65351,  65362,  65373,  65383,  65392,  65401,  65409,
+   65417,  65424,  65431,  65437,  65443,  65449,  65454,  65459,
+   65464,  65468,  65472,  65476,  65480,  65483,  65486,  65489,
+   65492,  65495,  65497,  65500,  65502,  65504,  65506,  65508,
+   65509,  65511,  65512,  65514,  65515,  65516,  65518,  65519,
+   65520,  65521,  65522,  65523,  65523,  65524,  65525,  65526,
+   65526,  65527,  65527,  65528,  65528,  65529,  65529,  65530,
+   65530,  65530,  65531,  65531,  65531,  65532,  65532,  65532,
+   65532,  65533,  65533,  65533,  65533,  65533,  65534,  65534,
+   65534,  65534,  65534,  65534,  65534,  65534,  65534,  65535,
+   65535,  65535,  65535,  65535,  65535,  65535,  65535,  65535,
+   65535,  65535,  65535,  65535,  65535,  65535,  65535,  65535,
+   65536,  65536,  65536,  65536,  65536,  65536,  65536,  65536,
+   65536,  65536,  65536,  65536,  65536,  65536,  65536,  65536,
+   65536,  65536,  65536,  65536,  65536,  65536,  65536,  65536,
+   65536,  65536,  65536,  65536,  65536,  65536,  65536,  65536,
+   65536,  65536,  65536,  65536,  65536,  65536,  65536,  65536,
+   65536,  65536,  65536,  65536,  65536,  65536,  65536,  65536,
+   65536,  65536,  65536,  65536,  65536,  65536,  65536,  65536,
+   65536,
+};
+
+const int kTableSteps = 512;
+// log2 of the table spacing in Q16.16 raw units, 1/16 -> 2^12.
+const int kStepShift = 12;
+const int32_t kRangeRaw = 16 << 16;
+
+} // namespace
+
+Q16_16 FixedSquash(Q16_16 x) {
+  if (x.raw <= -kRangeRaw) return Q16_16::FromRaw(kSquashTable[0]);
+  if (x.raw >= kRangeRaw) return Q16_16::FromRaw(kSquashTable[kTableSteps]);
+
+  const int32_t offset = x.raw + kRangeRaw;
+  const int i = offset >> kStepShift;
+  const int32_t frac = offset & ((1 << kStepShift) - 1);
+  const int32_t lo = kSquashTable[i];
+  const int32_t hi = kSquashTable[i + 1];
+  const int64_t step = int64_t(hi - lo) * frac + (1 << (kStepShift - 1));
+  return Q16_16::FromRaw(lo + static_cast<int32_t>(step >> kStepShift));
+}
@@ -0,0 +1,21 @@
+#ifndef FIXED_PID_H
+#define FIXED_PID_H
+
+#include "basic_pid.h"
+#include "fixed_point.h"
+
+/*
+* PID running entirely in Q16.16 saturating integer arithmetic, for
+* targets without an FPU. Same control law and gain fields as PID.
+*/
+typedef BasicPID<Q16_16, pid::Policy<pid::RuntimeGains<Q16_16> > > FixedPID;
+
+/*
+* Integer replacement for the steering squash 2 / (1 + exp(-x)) - 1, which
+* equals tanh(x / 2). Uses a 513 entry table over [-16, 16] with linear
+* interpolation; the result is within 1.5e-4 of the exact value for all
+* inputs (see bench_fixed_pid).
+*/
+Q16_16 FixedSquash(Q16_16 x);
+
+#endif /* FIXED_PID_H */
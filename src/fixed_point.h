@@ -0,0 +1,80 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <cstdint>
+
+/*
+* Signed 32-bit fixed-point number with FracBits fractional bits. Every
+* operation saturates at the representable range instead of wrapping, and
+* only integer arithmetic is used, so it runs on cores without an FPU.
+* Construction from double is constexpr, so constants fold at compile time.
+*/
+template <int FracBits>
+class Fixed {
+  static_assert(FracBits > 0 && FracBits < 32, "need 1 to 31 fraction bits");
+
+public:
+  static const int kFracBits = FracBits;
+
+  int32_t raw;
+
+  constexpr Fixed() : raw(0) {}
+  constexpr Fixed(double x) : raw(FromDouble(x * (int64_t(1) << FracBits))) {}
+
+  static Fixed FromRaw(int32_t raw) {
+    Fixed f;
+    f.raw = raw;
+    return f;
+  }
+
+  static constexpr int32_t Max() { return INT32_MAX; }
+  static constexpr int32_t Min() { return INT32_MIN; }
+
+  double ToDouble() const {
+    return static_cast<double>(raw) / (int64_t(1) << FracBits);
+  }
+
+  /*
+  * Clamp a wide intermediate result into 32 bits.
+  */
+  static int32_t Saturate(int64_t v) {
+    return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : static_cast<int32_t>(v));
+  }
+
+  Fixed operator+(Fixed o) const { return FromRaw(Saturate(int64_t(raw) + o.raw)); }
+  Fixed operator-(Fixed o) const { return FromRaw(Saturate(int64_t(raw) - o.raw)); }
+  Fixed operator-() const { return FromRaw(Saturate(-int64_t(raw))); }
+
+  /*
+  * Product rounded to nearest.
+  */
+  Fixed operator*(Fixed o) const {
+    int64_t p = int64_t(raw) * o.raw;
+    p += int64_t(1) << (FracBits - 1);
+    return FromRaw(Saturate(p >> FracBits));
+  }
+
+  bool operator<(Fixed o) const { return raw < o.raw; }
+  bool operator>(Fixed o) const { return raw > o.raw; }
+  bool operator<=(Fixed o) const { return raw <= o.raw; }
+  bool operator>=(Fixed o) const { return raw >= o.raw; }
+  bool operator==(Fixed o) const { return raw == o.raw; }
+  bool operator!=(Fixed o) const { return raw != o.raw; }
+
+private:
+  // Rounds half away from zero and saturates, as one constexpr expression.
+  static constexpr int32_t FromDouble(double scaled) {
+    return scaled >= 2147483647.0 ? INT32_MAX
+         : scaled <= -2147483648.0 ? INT32_MIN
+         : static_cast<int32_t>(scaled >= 0 ? scaled + 0.5 : scaled - 0.5);
+  }
+};
+
+/*
+* Q16.16 covers +-32768 with a resolution of 1.5e-5, enough for cte, speed
+* errors and gains. Q31 covers [-1, 1) and suits normalized actuator values.
+*/
+typedef Fixed<16> Q16_16;
+typedef Fixed<31> Q31;
+
+#endif /* FIXED_POINT_H */
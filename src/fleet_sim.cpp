@@ -0,0 +1,135 @@
+#include "fleet_sim.h"
+#include <math.h>
+#include "controller.h"
+
+namespace {
+
+// Cars stepped together by one thread; keeps a chunk's state in L1.
+const size_t kChunk = 64;
+
+double Clamp(double x, double lo, double hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+
+} // namespace
+
+FleetSim::FleetSim(const Track &track, const Simulator::Params &params,
+                   size_t cars)
+    : x(cars), y(cars), psi(cars), v(cars), delta(cars), cte(cars),
+      distance(cars), steer(cars), speed(cars), track_(track),
+      params_(params), hint_(cars), rng_(cars), measured_cte_(cars),
+      steps_(cars), cte_sq_sum_(cars), max_cte_(cars), off_track_(cars),
+      speed_err_(cars), steer_out_(cars), speed_out_(cars) {
+  Controller controller;
+  steer_shape = controller.steer_shape;
+  for (size_t i = 0; i < cars; ++i) {
+    const PID &s = controller.pid_steer;
+    const PID &p = controller.pid_speed;
+    steer.Init(i, s.Kp, s.Ki, s.Kd);
+    speed.Init(i, p.Kp, p.Ki, p.Kd);
+    Reset(i, 0);
+  }
+}
+
+void FleetSim::Reset(size_t i, unsigned seed) {
+
+  steer.Init(i, steer.Kp[i], steer.Ki[i], steer.Kd[i]);
+  speed.Init(i, speed.Kp[i], speed.Ki[i], speed.Kd[i]);
+
+  // Same as Simulator::Reset.
+  hint_[i] = 0;
+  rng_[i].seed(seed);
+  x[i] = track_.xs[0];
+  y[i] = track_.ys[0];
+  cte[i] = track_.Cte(x[i], y[i], &hint_[i], &psi[i]);
+  v[i] = 0;
+  delta[i] = 0;
+  distance[i] = 0;
+  Measure(i);
+
+  steps_[i] = 0;
+  cte_sq_sum_[i] = 0;
+  max_cte_[i] = 0;
+  off_track_[i] = 0;
+}
+
+void FleetSim::Measure(size_t i) {
+
+  measured_cte_[i] = cte[i];
+  if (params_.cte_noise > 0) {
+    std::normal_distribution<double> noise(0, params_.cte_noise);
+    measured_cte_[i] += noise(rng_[i]);
+  }
+}
+
+void FleetSim::Run(int steps, ThreadPool *pool) {
+
+  const size_t chunks = (size() + kChunk - 1) / kChunk;
+  auto job = [this, steps](size_t c) {
+    size_t begin = c * kChunk;
+    size_t end = begin + kChunk < size() ? begin + kChunk : size();
+    RunChunk(begin, end, steps);
+  };
+  if (pool) {
+    pool->Run(chunks, job);
+  } else {
+    for (size_t c = 0; c < chunks; ++c) job(c);
+  }
+}
+
+void FleetSim::RunChunk(size_t begin, size_t end, int steps) {
+
+  const double dt = params_.dt;
+  const double half_width = track_.half_width;
+  const size_t n = end - begin;
+
+  for (int step = 0; step < steps; ++step) {
+    size_t active = 0;
+    for (size_t k = begin; k < end; ++k) {
+      active += !off_track_[k];
+      speed_err_[k] = v[k] * Simulator::kMphPerMps - Controller::kTargetSpeed;
+    }
+    if (!active) return;
+
+    // Controller::Update for the whole chunk. Cars already off the road
+    // keep being updated but their state is no longer advanced.
+    steer.Update(measured_cte_.data(), steer_out_.data(), begin, end);
+    ShapeSteerBatch(steer_shape, &steer_out_[begin], &steer_out_[begin], n);
+    speed.Update(speed_err_.data(), speed_out_.data(), begin, end);
+    for (size_t k = begin; k < end; ++k) {
+      double throttle = Controller::Throttle(speed_out_[k], &speed_out_[k]);
+      speed.BackCalculate(k, throttle, speed_out_[k],
+                          Controller::kSpeedTrackingGain);
+    }
+
+    // Simulator::Step and the RunEpisode bookkeeping.
+    for (size_t k = begin; k < end; ++k) {
+      if (off_track_[k]) continue;
+      delta[k] = Clamp(steer_out_[k], -1, 1);
+      double throttle = Clamp(speed_out_[k], -1, 1);
+
+      double wheel = delta[k] * params_.max_steer * M_PI / 180;
+      x[k] += v[k] * cos(psi[k]) * dt;
+      y[k] += v[k] * sin(psi[k]) * dt;
+      psi[k] -= v[k] / params_.wheelbase * tan(wheel) * dt;
+      distance[k] += v[k] * dt;
+      v[k] += (throttle * params_.max_accel - params_.drag * v[k]) * dt;
+      if (v[k] < 0) v[k] = 0;
+
+      cte[k] = track_.Cte(x[k], y[k], &hint_[k], nullptr);
+      Measure(k);
+
+      steps_[k] += 1;
+      cte_sq_sum_[k] += cte[k] * cte[k];
+      if (fabs(cte[k]) > max_cte_[k]) max_cte_[k] = fabs(cte[k]);
+      if (cte[k] > half_width || cte[k] < -half_width) off_track_[k] = 1;
+    }
+  }
+}
+
+EpisodeResult FleetSim::Result(size_t i) const {
+
+  EpisodeResult r = { steps_[i], cte_sq_sum_[i], max_cte_[i], distance[i],
+                      off_track_[i] != 0 };
+  return r;
+}
@@ -0,0 +1,104 @@
+#ifndef FLEET_SIM_H
+#define FLEET_SIM_H
+
+#include <cstddef>
+#include <random>
+#include <vector>
+#include "output_shaping.h"
+#include "pid_bank.h"
+#include "simulator.h"
+#include "thread_pool.h"
+
+/*
+* Many independent cars on one Track, stored as structure of arrays. Each
+* car runs the Controller law (steering and speed PID, steering shape,
+* throttle clamp and speed anti-windup) through PIDBank, ShapeSteerBatch,
+* Controller::Throttle and PIDBank::BackCalculate, and the Simulator
+* vehicle model, with the same operations in the same order, so car i
+* gives bit for bit the EpisodeResult of RunEpisode with a default
+* Controller using its steering gains and a Simulator seeded with its
+* seed. The frame period is fixed: the per-frame update is used and
+* dt_jitter is ignored. Speed targets other than the default and gain
+* schedules are not supported.
+*
+* Only the controller step is vectorized. The noise draw, the libm trig of
+* the vehicle model and the centerline search stay scalar per car, since
+* vector versions would not round the same, and they take most of the
+* time: one thread runs about 10% faster than the scalar path at -O2.
+* Throughput comes from running chunks on a ThreadPool, which a pool of
+* whole RunEpisode calls matches (bench_fleet times both). What the layout
+* adds is lockstep: between Run calls every car is at the same frame with
+* its state in the arrays below, so a population can be stepped a few
+* frames at a time and compared, or restarted with Reset, mid-episode.
+*/
+class FleetSim {
+public:
+  /*
+  * Car state, as the Simulator members of the same name.
+  */
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> psi;
+  std::vector<double> v;
+  std::vector<double> delta;
+  std::vector<double> cte;
+  std::vector<double> distance;
+
+  /*
+  * Controllers of every car, initialized with the Controller gains.
+  */
+  PIDBank steer;
+  PIDBank speed;
+
+  /*
+  * Shape bounding the steering output of every car.
+  */
+  SteerShape steer_shape;
+
+  /*
+  * All cars start on the start line with seed 0.
+  */
+  FleetSim(const Track &track, const Simulator::Params &params, size_t cars);
+
+  size_t size() const { return x.size(); }
+
+  /*
+  * Put car i back on the start line at rest with cleared controllers and
+  * statistics, and restart its noise sequence from seed. Gains are kept.
+  */
+  void Reset(size_t i, unsigned seed);
+
+  /*
+  * Advance every car still on the road by up to steps frames, stopping
+  * each one when it leaves the road. Cars are split into fixed chunks run
+  * on the pool when one is given; results do not depend on the pool.
+  */
+  void Run(int steps, ThreadPool *pool = nullptr);
+
+  /*
+  * Summary of car i since its last Reset, as returned by RunEpisode.
+  */
+  EpisodeResult Result(size_t i) const;
+
+private:
+  const Track &track_;
+  Simulator::Params params_;
+
+  std::vector<size_t> hint_;
+  std::vector<std::mt19937> rng_;
+  std::vector<double> measured_cte_;
+  std::vector<int> steps_;
+  std::vector<double> cte_sq_sum_;
+  std::vector<double> max_cte_;
+  std::vector<char> off_track_;
+
+  // Per tick scratch, indexed like the cars.
+  std::vector<double> speed_err_;
+  std::vector<double> steer_out_;
+  std::vector<double> speed_out_;
+
+  void Measure(size_t i);
+  void RunChunk(size_t begin, size_t end, int steps);
+};
+
+#endif /* FLEET_SIM_H */
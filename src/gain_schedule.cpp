@@ -0,0 +1,141 @@
+#include "gain_schedule.h"
+#include <fstream>
+#include <sstream>
+#include "json.hpp"
+
+// for convenience
+using json = nlohmann::json;
+
+GainSchedule::GainSchedule() : angle_points_(1) {
+  speed_ = MakeAxis(0, 0, 1);
+  angle_ = MakeAxis(0, 0, 1);
+}
+
+GainSchedule::Axis GainSchedule::MakeAxis(double min, double max,
+                                          int points) {
+  Axis axis;
+  axis.min = min;
+  axis.last = points - 1;
+  axis.inv_step = points > 1 ? (points - 1) / (max - min) : 0;
+  return axis;
+}
+
+void GainSchedule::Resize(double speed_min, double speed_max, int speed_points,
+                          double angle_min, double angle_max,
+                          int angle_points) {
+  speed_ = MakeAxis(speed_min, speed_max, speed_points);
+  angle_ = MakeAxis(angle_min, angle_max, angle_points);
+  angle_points_ = angle_points;
+  Gains zero = { 0, 0, 0 };
+  table_.assign(speed_points * angle_points, zero);
+}
+
+void GainSchedule::Locate(const Axis &axis, double x, int *lo, int *hi,
+                          double *t) {
+  // Position in grid units, clamped to [0, last]; the compiler turns the
+  // ternaries into min/max and conditional moves.
+  double f = (x - axis.min) * axis.inv_step;
+  f = f > 0 ? f : 0;
+  f = f < axis.last ? f : axis.last;
+  int i = static_cast<int>(f);
+  *lo = i;
+  *hi = i < axis.last ? i + 1 : i;
+  *t = f - i;
+}
+
+GainSchedule::Gains GainSchedule::Lookup(double speed, double angle) const {
+
+  int s0, s1, a0, a1;
+  double ts, ta;
+  Locate(speed_, speed, &s0, &s1, &ts);
+  Locate(angle_, angle, &a0, &a1, &ta);
+
+  const Gains &g00 = table_[s0 * angle_points_ + a0];
+  const Gains &g01 = table_[s0 * angle_points_ + a1];
+  const Gains &g10 = table_[s1 * angle_points_ + a0];
+  const Gains &g11 = table_[s1 * angle_points_ + a1];
+  const double w00 = (1 - ts) * (1 - ta);
+  const double w01 = (1 - ts) * ta;
+  const double w10 = ts * (1 - ta);
+  const double w11 = ts * ta;
+
+  Gains g;
+  g.kp = w00 * g00.kp + w01 * g01.kp + w10 * g10.kp + w11 * g11.kp;
+  g.ki = w00 * g00.ki + w01 * g01.ki + w10 * g10.ki + w11 * g11.ki;
+  g.kd = w00 * g00.kd + w01 * g01.kd + w10 * g10.kd + w11 * g11.kd;
+  return g;
+}
+
+bool GainSchedule::Parse(const std::string &text, std::string *error) {
+
+  json j;
+  try {
+    j = json::parse(text);
+  } catch (const std::exception &e) {
+    *error = e.what();
+    return false;
+  }
+
+  double axes[2][3] = { { 0, 0, 1 }, { 0, 0, 1 } };
+  const char *names[2] = { "speed", "angle" };
+  for (int a = 0; a < 2; ++a) {
+    if (!j.count(names[a])) {
+      if (a == 0) {
+        *error = "missing \"speed\" axis";
+        return false;
+      }
+      continue;
+    }
+    const json &axis = j[names[a]];
+    if (!axis.is_array() || axis.size() != 3 || !axis[0].is_number() ||
+        !axis[1].is_number() || !axis[2].is_number()) {
+      *error = std::string("\"") + names[a] + "\" must be [first, last, points]";
+      return false;
+    }
+    for (int k = 0; k < 3; ++k) axes[a][k] = axis[k].get<double>();
+    int points = static_cast<int>(axes[a][2]);
+    if (points < 1 || points != axes[a][2] ||
+        (points > 1 && !(axes[a][1] > axes[a][0]))) {
+      *error = std::string("bad \"") + names[a] + "\" axis";
+      return false;
+    }
+  }
+
+  const int speed_points = static_cast<int>(axes[0][2]);
+  const int angle_points = static_cast<int>(axes[1][2]);
+  const json &gains = j.count("gains") ? j["gains"] : json();
+  if (!gains.is_array() ||
+      gains.size() != static_cast<size_t>(speed_points * angle_points)) {
+    *error = "\"gains\" must hold speed points x angle points entries";
+    return false;
+  }
+  for (const json &g : gains) {
+    if (!g.is_array() || g.size() != 3 || !g[0].is_number() ||
+        !g[1].is_number() || !g[2].is_number()) {
+      *error = "every gain entry must be [Kp, Ki, Kd]";
+      return false;
+    }
+  }
+
+  Resize(axes[0][0], axes[0][1], speed_points, axes[1][0], axes[1][1],
+         angle_points);
+  for (size_t k = 0; k < gains.size(); ++k) {
+    Gains &g = table_[k];
+    g.kp = gains[k][0].get<double>();
+    g.ki = gains[k][1].get<double>();
+    g.kd = gains[k][2].get<double>();
+  }
+  return true;
+}
+
+bool GainSchedule::Load(const std::string &path, std::string *error) {
+
+  std::ifstream in(path);
+  if (!in) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  std::stringstream text;
+  text << in.rdbuf();
+  return Parse(text.str(), error);
+}
@@ -0,0 +1,79 @@
+#ifndef GAIN_SCHEDULE_H
+#define GAIN_SCHEDULE_H
+
+#include <string>
+#include <vector>
+
+/*
+* PID gains interpolated over a uniform grid of speed (mph) and, optionally,
+* absolute smoothed steering angle (degrees). Lookups clamp to the grid
+* edges and blend the four surrounding points bilinearly without data
+* dependent branches; the table is a flat array of a few hundred bytes that
+* stays in L1.
+*
+* File format (JSON), with each axis given as [first, last, points]; the
+* angle axis is optional and "gains" lists speed points x angle points
+* entries, speed major:
+*
+*   { "speed": [30, 90, 4],
+*     "angle": [0, 10, 2],
+*     "gains": [[Kp, Ki, Kd], ...] }
+*/
+class GainSchedule {
+public:
+  struct Gains {
+    double kp;
+    double ki;
+    double kd;
+  };
+
+  /*
+  * Empty schedule, Lookup must not be called.
+  */
+  GainSchedule();
+
+  /*
+  * Set up the grid, with every point at zero gains. Axes with one point
+  * ignore their coordinate.
+  */
+  void Resize(double speed_min, double speed_max, int speed_points,
+              double angle_min = 0, double angle_max = 0,
+              int angle_points = 1);
+
+  bool empty() const { return table_.empty(); }
+
+  /*
+  * Gains at grid point (speed index i, angle index j).
+  */
+  Gains &at(int i, int j = 0) { return table_[i * angle_points_ + j]; }
+
+  /*
+  * Interpolated gains at the given speed and absolute steering angle.
+  */
+  Gains Lookup(double speed, double angle = 0) const;
+
+  /*
+  * Parse a schedule from JSON text or a file. On failure the schedule is
+  * left unchanged and error describes the problem.
+  */
+  bool Parse(const std::string &text, std::string *error);
+  bool Load(const std::string &path, std::string *error);
+
+private:
+  struct Axis {
+    double min;
+    double inv_step;  // 0 for a single point
+    int last;         // index of the last point
+  };
+
+  Axis speed_;
+  Axis angle_;
+  int angle_points_;
+  std::vector<Gains> table_;
+
+  static Axis MakeAxis(double min, double max, int points);
+  static void Locate(const Axis &axis, double x, int *lo, int *hi,
+                     double *t);
+};
+
+#endif /* GAIN_SCHEDULE_H */
@@ -0,0 +1,91 @@
+#include "latency.h"
+#include <cstdio>
+
+namespace {
+
+const char *const kStageNames[] = {
+  "framing", "parse", "json_fallback", "control", "serialize", "send", "total"
+};
+
+int HighestBit(uint64_t v) {
+  return 63 - __builtin_clzll(v);
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram() {
+  Reset();
+}
+
+int LatencyHistogram::Index(uint64_t ns) {
+  // Values below 2 * kSubBuckets get a bucket each, above that the top
+  // five bits select the bucket.
+  if (ns < 2 * kSubBuckets) return static_cast<int>(ns);
+  int shift = HighestBit(ns) - 4;
+  int index = shift * kSubBuckets + static_cast<int>(ns >> shift);
+  return index < kBuckets ? index : kBuckets - 1;
+}
+
+uint64_t LatencyHistogram::UpperBound(int index) {
+  if (index < 2 * kSubBuckets) return index;
+  int shift = index / kSubBuckets - 1;
+  uint64_t sub = index % kSubBuckets + kSubBuckets;
+  return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t ns) {
+  counts_[Index(ns)].fetch_add(1, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (ns > max &&
+         !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::Count() const {
+  uint64_t total = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    total += counts_[i].load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+uint64_t LatencyHistogram::Percentile(double q) const {
+  uint64_t total = Count();
+  if (total == 0) return 0;
+  uint64_t rank = static_cast<uint64_t>(q * total);
+  if (rank >= total) rank = total - 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += counts_[i].load(std::memory_order_relaxed);
+    if (seen > rank) {
+      uint64_t bound = UpperBound(i);
+      uint64_t max = Max();
+      return bound < max ? bound : max;
+    }
+  }
+  return Max();
+}
+
+void LatencyHistogram::Reset() {
+  for (int i = 0; i < kBuckets; ++i) counts_[i].store(0);
+  max_.store(0);
+}
+
+LatencyStats &LatencyStats::Get() {
+  static LatencyStats stats;
+  return stats;
+}
+
+std::string LatencyStats::Summary() const {
+  std::string out = "stage              count      p50      p99    p99.9      max (us)\n";
+  char line[128];
+  for (int i = 0; i < static_cast<int>(Stage::kCount); ++i) {
+    const LatencyHistogram &h = stages_[i];
+    snprintf(line, sizeof(line), "%-13s %10llu %8.2f %8.2f %8.2f %8.2f\n",
+             kStageNames[i], static_cast<unsigned long long>(h.Count()),
+             h.Percentile(0.5) / 1e3, h.Percentile(0.99) / 1e3,
+             h.Percentile(0.999) / 1e3, h.Max() / 1e3);
+    out += line;
+  }
+  return out;
+}
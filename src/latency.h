@@ -0,0 +1,86 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+* HDR-style latency histogram. Values in nanoseconds go into log-linear
+* buckets, 16 per power of two, so any recorded value is reported within
+* about 6% of its true size, from 1 ns up to about 30 minutes. Record is
+* a single relaxed atomic increment and may be called from any thread.
+*/
+class LatencyHistogram {
+public:
+  static const int kSubBuckets = 16;
+  static const int kBuckets = 38 * kSubBuckets;
+
+  LatencyHistogram();
+
+  void Record(uint64_t ns);
+
+  /*
+  * Value below which the fraction q of all samples lie, in ns.
+  */
+  uint64_t Percentile(double q) const;
+
+  uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+  uint64_t Count() const;
+
+  void Reset();
+
+private:
+  static int Index(uint64_t ns);
+  static uint64_t UpperBound(int index);
+
+  std::atomic<uint64_t> counts_[kBuckets];
+  std::atomic<uint64_t> max_;
+};
+
+/*
+* Stages of the onMessage pipeline, in order.
+*/
+enum class Stage {
+  kFraming,       // "42" event check
+  kParse,         // ParseTelemetry
+  kJsonFallback,  // hasData + json::parse for non-telemetry events
+  kControl,       // Controller update and Twiddle
+  kSerialize,     // ReplyWriter
+  kSend,          // ws.send
+  kTotal,         // frame received to last send returned
+  kCount
+};
+
+/*
+* Process-wide histograms, one per Stage.
+*/
+class LatencyStats {
+public:
+  static LatencyStats &Get();
+
+  LatencyHistogram &operator[](Stage stage) {
+    return stages_[static_cast<int>(stage)];
+  }
+
+  /*
+  * Plain text table with count, p50, p99, p99.9 and max per stage, in
+  * microseconds.
+  */
+  std::string Summary() const;
+
+private:
+  LatencyHistogram stages_[static_cast<int>(Stage::kCount)];
+};
+
+/*
+* Monotonic clock in nanoseconds used for all latency samples.
+*/
+inline uint64_t LatencyNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif /* LATENCY_H */
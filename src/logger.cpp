@@ -0,0 +1,163 @@
+#include "logger.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// How long the drain thread sleeps when every ring is empty.
+const std::chrono::milliseconds kIdleSleep(2);
+
+} // namespace
+
+/*
+* Single-producer single-consumer ring of fixed-size messages. Only the
+* owning thread advances head, only the drain thread advances tail.
+*/
+struct Logger::Ring {
+  struct Slot {
+    uint32_t length;
+    char text[kMessageSize];
+  };
+
+  Slot slots[kRingSlots];
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> tail;
+  std::atomic<uint64_t> dropped;
+
+  // Token bucket, touched by the producer only.
+  double tokens;
+  uint64_t refill_ns;
+
+  Ring() : head(0), tail(0), dropped(0), tokens(0), refill_ns(0) {}
+};
+
+Logger &Logger::Get() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::Logger()
+    : level_(static_cast<int>(LogLevel::kInfo)), rate_limit_(0),
+      stop_(false) {
+  drain_ = std::thread(&Logger::DrainLoop, this);
+}
+
+Logger::~Logger() {
+  stop_.store(true);
+  drain_.join();
+  for (Ring *ring : rings_) delete ring;
+}
+
+Logger::Ring *Logger::LocalRing() {
+  static thread_local Ring *ring = nullptr;
+  if (!ring) {
+    ring = new Ring();
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings_.push_back(ring);
+  }
+  return ring;
+}
+
+void Logger::Log(LogLevel level, const char *format, ...) {
+  Ring *ring = LocalRing();
+
+  unsigned limit = rate_limit_.load(std::memory_order_relaxed);
+  if (limit) {
+    uint64_t now = NowNs();
+    ring->tokens += (now - ring->refill_ns) * 1e-9 * limit;
+    if (ring->tokens > limit) ring->tokens = limit;
+    ring->refill_ns = now;
+    if (ring->tokens < 1) {
+      ring->dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    ring->tokens -= 1;
+  }
+
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= kRingSlots) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  static const char *const kPrefix[] = { "D ", "I ", "W ", "E " };
+  Ring::Slot &slot = ring->slots[head % kRingSlots];
+  memcpy(slot.text, kPrefix[static_cast<int>(level)], 2);
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(slot.text + 2, kMessageSize - 2, format, args);
+  va_end(args);
+  if (n < 0) n = 0;
+  size_t length = 2 + (static_cast<size_t>(n) < kMessageSize - 3 ? n : kMessageSize - 3);
+  slot.text[length++] = '\n';
+  slot.length = static_cast<uint32_t>(length);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Logger::DrainOnce() {
+  std::vector<Ring *> rings;
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings = rings_;
+  }
+  bool wrote = false;
+  for (Ring *ring : rings) {
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      const Ring::Slot &slot = ring->slots[tail % kRingSlots];
+      fwrite(slot.text, 1, slot.length, stdout);
+      wrote = true;
+    }
+    ring->tail.store(tail, std::memory_order_release);
+
+    uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped) {
+      fprintf(stdout, "W %llu log messages dropped\n",
+              static_cast<unsigned long long>(dropped));
+      wrote = true;
+    }
+  }
+  if (wrote) fflush(stdout);
+  return wrote;
+}
+
+void Logger::DrainLoop() {
+  while (!stop_.load()) {
+    if (!DrainOnce()) std::this_thread::sleep_for(kIdleSleep);
+  }
+  DrainOnce();
+}
+
+void Logger::Flush() {
+  // Wait until the drain thread has caught up with every ring.
+  for (;;) {
+    bool pending = false;
+    {
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      for (Ring *ring : rings_) {
+        pending = pending || ring->head.load() != ring->tail.load();
+      }
+    }
+    if (!pending) return;
+    std::this_thread::sleep_for(kIdleSleep);
+  }
+}
+
+bool Logger::ParseLevel(const char *name, LogLevel *level) {
+  static const char *const kNames[] = { "debug", "info", "warn", "error", "off" };
+  for (int i = 0; i < 5; ++i) {
+    if (!strcmp(name, kNames[i])) {
+      *level = static_cast<LogLevel>(i);
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,86 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class LogLevel { kDebug = 0, kInfo, kWarn, kError, kOff };
+
+/*
+* Asynchronous console logger for the control loop. Each producing thread
+* formats into its own lock-free single-producer ring, and a background
+* thread drains all rings to stdout. Logging never blocks: when a ring is
+* full or the thread exceeds its rate limit, the message is dropped and
+* counted, and the drain thread later reports how many were lost.
+*/
+class Logger {
+public:
+  static const size_t kMessageSize = 256;
+  static const size_t kRingSlots = 1024;
+
+  /*
+  * Process-wide instance, the drain thread starts on first use.
+  */
+  static Logger &Get();
+
+  ~Logger();
+
+  void SetLevel(LogLevel level) { level_.store(static_cast<int>(level)); }
+  bool Enabled(LogLevel level) const {
+    return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+  }
+
+  /*
+  * Maximum messages per second per producing thread, 0 for unlimited.
+  */
+  void SetRateLimit(unsigned per_second) { rate_limit_.store(per_second); }
+
+  /*
+  * printf-style message, queued on the calling thread's ring.
+  */
+  void Log(LogLevel level, const char *format, ...)
+      __attribute__((format(printf, 3, 4)));
+
+  /*
+  * Wait until everything queued so far has been written.
+  */
+  void Flush();
+
+  /*
+  * Parse "debug", "info", "warn", "error" or "off".
+  */
+  static bool ParseLevel(const char *name, LogLevel *level);
+
+private:
+  struct Ring;
+
+  Logger();
+  Ring *LocalRing();
+  bool DrainOnce();
+  void DrainLoop();
+
+  std::atomic<int> level_;
+  std::atomic<unsigned> rate_limit_;
+  std::mutex rings_mutex_;
+  std::vector<Ring *> rings_;
+  std::thread drain_;
+  std::atomic<bool> stop_;
+};
+
+#define LOG(level, ...)                                   \
+  do {                                                    \
+    if (Logger::Get().Enabled(level)) {                   \
+      Logger::Get().Log(level, __VA_ARGS__);              \
+    }                                                     \
+  } while (0)
+
+#define LOG_DEBUG(...) LOG(LogLevel::kDebug, __VA_ARGS__)
+#define LOG_INFO(...) LOG(LogLevel::kInfo, __VA_ARGS__)
+#define LOG_WARN(...) LOG(LogLevel::kWarn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG(LogLevel::kError, __VA_ARGS__)
+
+#endif /* LOGGER_H */
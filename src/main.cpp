@@ -1,9 +1,18 @@
 #include <uWS/uWS.h>
 #include <iostream>
+#include "checkpoint.h"
+#include "config.h"
 #include "json.hpp"
-#include "PID.h"
+#include "latency.h"
+#include "logger.h"
+#include "metrics.h"
+#include "session.h"
 #include <math.h>
-#include <limits>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 // for convenience
 using json = nlohmann::json;
@@ -13,232 +22,243 @@ constexpr double pi() { return M_PI; }
 double deg2rad(double x) { return x * pi() / 180; }
 double rad2deg(double x) { return x * 180 / pi(); }
 
-// Checks if the SocketIO event has JSON data.
-// If there is data the JSON object in string format will be returned,
-// else the empty string "" will be returned.
-std::string hasData(std::string s) {
-  auto found_null = s.find("null");
-  auto b1 = s.find_first_of("[");
-  auto b2 = s.find_last_of("]");
-  if (found_null != std::string::npos) {
-    return "";
-  }
-  else if (b1 != std::string::npos && b2 != std::string::npos) {
-    return s.substr(b1, b2 - b1 + 1);
-  }
-  return "";
-}
+// Source of the session ids written to the telemetry log.
+std::atomic<uint32_t> next_session_id(0);
 
-int main()
+// Registers the websocket and HTTP handlers on a hub. A connection is only
+// ever served by the hub that accepted it, so its Session needs no locking.
+// Every new Session starts from the current configuration.
+void ConfigureHub(uWS::Hub &h, ConfigStore *config, TelemetryRecorder *recorder,
+                  Checkpoint *checkpoint)
 {
-  uWS::Hub h;
-
-  PID pid_steer, pid_speed;
-  // TODO: Initialize the pid variable.
-  pid_steer.Init(0.212221, 0.00974437, 3.01065);
-  pid_speed.Init(0.006, 0.00001, 0.0001);
-
-  std::deque<double> angle_history;
-
-  bool use_twiddle = false;
-  double twiddle_tol = 0.0002;
-  double twiddle_best = std::numeric_limits<double>::max();
-  double twiddle_err = 0;
-  //double twiddle_p[] = { 0.0002, 0.00001, 0.0001 };
-  //Delta: 0.00473514 , 0.000864536 , 0.00707348
-  double twiddle_p[] = {0.01, 0.001, 0.01};
-
-  int twiddle_steps = 1000;
-  int twiddle_num = 0;
-  int twiddle_try = 0;
-  int twiddle_idx = 0;
-
-  h.onMessage([&pid_steer, &pid_speed, &angle_history, &use_twiddle,
-  &twiddle_tol, &twiddle_steps, &twiddle_num, &twiddle_best,
-  &twiddle_try, &twiddle_err, &twiddle_p, &twiddle_idx
-  ](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length, uWS::OpCode opCode) {
-    // "42" at the start of the message means there's a websocket message event.
-    // The 4 signifies a websocket message
-    // The 2 signifies a websocket event
-    if (length && length > 2 && data[0] == '4' && data[1] == '2')
-    {
-      auto s = hasData(std::string(data));
-      if (s != "") {
-        auto j = json::parse(s);
-        std::string event = j[0].get<std::string>();
-        if (event == "telemetry") {
-          // j[1] is the data JSON object
-          double cte = std::stod(j[1]["cte"].get<std::string>());
-          double speed = std::stod(j[1]["speed"].get<std::string>());
-          double angle = std::stod(j[1]["steering_angle"].get<std::string>());
-          double steer_value;
-          double speed_err;
-          double target_speed;
-          double throttle;
-
-          /**
-           * Twiddle
-           */
-          if (use_twiddle && twiddle_num == 0) {
-            if (twiddle_idx == 0) { pid_steer.Kp += twiddle_p[0]; }
-            if (twiddle_idx == 1) { pid_steer.Ki += twiddle_p[1]; }
-            if (twiddle_idx == 2) { pid_steer.Kd += twiddle_p[2]; }
-            std::cout << " = " << twiddle_idx << "  "
-                      << " Kp: " << pid_steer.Kp
-                      << " Ki: " << pid_steer.Ki
-                      << " Kd: " << pid_steer.Kd
-                      << std::endl;
-          }
-
-          /*
-          * TODO: Calcuate steering value here, remember the steering value is
-          * [-1, 1].
-          * NOTE: Feel free to play around with the throttle and speed. Maybe use
-          * another PID controller to control the speed!
-          */
-          // Steer
-          pid_steer.UpdateError(cte);
-          steer_value = pid_steer.TotalError();
-          // use sigmoid to limit the value between 1 and -1
-          steer_value = 2 / (1 + exp(-steer_value)) -1;
-
-          // Speed
-          // smooth out the angle
-          angle_history.push_back(angle);
-          if (angle_history.size() > 10)
-              angle_history.pop_front()
-
-          double avg_angle = angle;
-          if (angle_history.size() > 0) {
-              avg_angle = std::accumulate(
-                  angle_history.begin(),
-                  angle_history.end(), 0.0) /
-                  angle_history.size();
-          }
+  // Each connection owns a Session, stored as the socket's user data.
+  h.onMessage([](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length, uWS::OpCode opCode) {
+    uint64_t received = LatencyNow();
+    Session *session = static_cast<Session *>(ws.getUserData());
+    if (!session) return;
 
-          // Target speed
-          //target_speed = 90 - fabs(avg_angle) * 10;
-          target_speed = 50;
-
-          speed_err = speed - target_speed;
-          pid_speed.UpdateError(speed_err);
-          throttle = 0.5 + pid_speed.TotalError();
-
-          /**
-           * Twiddle
-           */
-          if (use_twiddle) {
-            twiddle_err += cte * cte;
-            if ((twiddle_num % 100) == 0) std::cout << twiddle_err / twiddle_num << std::endl;
-            if (twiddle_num == twiddle_steps) {
-              twiddle_err /= twiddle_steps;
-              if (twiddle_err < twiddle_best) {
-                twiddle_best = twiddle_err;
-                twiddle_p[twiddle_idx] *= 1.1;
-                twiddle_idx += 1;
-                twiddle_idx%= 3;
-              }
-              else {
-                if (twiddle_try == 0) {
-                  if (twiddle_idx == 0) { pid_steer.Kp -= 3*twiddle_p[0]; }
-                  if (twiddle_idx == 1) { pid_steer.Ki -= 3*twiddle_p[1]; }
-                  if (twiddle_idx == 2) { pid_steer.Kd -= 3*twiddle_p[2]; }
-                  twiddle_try = 1;
-                }
-                else {
-                  if (twiddle_idx == 0) { pid_steer.Kp += twiddle_p[0]; twiddle_p[0] *= 0.9; }
-                  if (twiddle_idx == 1) { pid_steer.Ki += twiddle_p[1]; twiddle_p[1] *= 0.9; }
-                  if (twiddle_idx == 2) { pid_steer.Kd += twiddle_p[2]; twiddle_p[2] *= 0.9; }
-                  twiddle_try = 0;
-                  twiddle_idx += 1;
-                  twiddle_idx %= 3;
-                }
-              }
-
-              if (twiddle_idx == 0) {
-                // check tolerance
-                double sum = twiddle_p[0] + twiddle_p[1] + twiddle_p[2];
-                std::cout << "Delta: " << twiddle_p[0]
-                          << " , " << twiddle_p[1]
-                          << " , " << twiddle_p[2] << std::endl;
-                std::cout << "Solution: "
-                          << " Kp: " << pid_steer.Kp
-                          << " Ki: " << pid_steer.Ki
-                          << " Kd: " << pid_steer.Kd
-                          << std::endl;
-                // reset
-                std::string msg = "42[\"reset\", {}]";
-                //std::cout << msg << std::endl;
-                ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
-              }
-              twiddle_num = 0;
-            }
-            else {
-              twiddle_num += 1;
-            }
-          }
-
-          // DEBUG
-          //if (twiddle_num % 10 == 0) {
-          //  std::cout << " Angle: " << avg_angle
-          //            << " Taget: " << target_speed
-          //            << " Speed: " << speed
-          //            << " Throttle: " << throttle
-          //            << std::endl;
-          //}
-
-          //std::cout << "CTE: " << cte << " Steering Value: " << steer_value << std::endl;
-          //std::cout << "Angle: " << angle << " Speed: " << speed << " Target: " << target_speed << std::endl;
-          //std::cout << "Throttle: " << throttle << std::endl;
-
-          json msgJson;
-          msgJson["steering_angle"] = steer_value;
-          msgJson["throttle"] = throttle;
-          auto msg = "42[\"steer\"," + msgJson.dump() + "]";
-          std::cout << msg << std::endl;
-          ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
-        }
-      } else {
-        // Manual driving
-        std::string msg = "42[\"manual\",{}]";
-        ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
-      }
+    Outgoing out[Session::kMaxReplies];
+    int n = session->OnMessage(data, length, out);
+    uint64_t start = LatencyNow();
+    for (int i = 0; i < n; ++i) {
+      ws.send(out[i].data, out[i].length, uWS::OpCode::TEXT);
+    }
+    uint64_t now = LatencyNow();
+    if (n) {
+      LatencyStats &stats = LatencyStats::Get();
+      stats[Stage::kSend].Record(now - start);
+      stats[Stage::kTotal].Record(now - received);
     }
   });
 
-  // We don't need this since we're not using HTTP but if it's removed the program
-  // doesn't compile :-(
+  // Plain HTTP on the same port serves Prometheus metrics at /metrics and a
+  // text latency summary at /latency. / gets a placeholder page and any
+  // other path a 404.
   h.onHttpRequest([](uWS::HttpResponse *res, uWS::HttpRequest req, char *data, size_t, size_t) {
     const std::string s = "<h1>Hello world!</h1>";
-    if (req.getUrl().valueLength == 1)
+    std::string url = req.getUrl().toString();
+    if (url == "/metrics")
+    {
+      std::string page = Metrics::Get().Render();
+      res->end(page.data(), page.length());
+    }
+    else if (url == "/latency")
+    {
+      std::string summary = LatencyStats::Get().Summary();
+      res->end(summary.data(), summary.length());
+    }
+    else if (url.length() == 1)
     {
       res->end(s.data(), s.length());
     }
     else
     {
-      // i guess this should be done more gracefully?
-      res->end(nullptr, 0);
+      // end() always answers 200 OK, so write our own status line instead;
+      // once a head has been written end() sends its data unchanged.
+      static const char kNotFound[] =
+          "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+      res->write(kNotFound, sizeof(kNotFound) - 1);
+      res->end();
     }
   });
 
-  h.onConnection([&h](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
-    std::cout << "Connected!!!" << std::endl;
+  h.onConnection([config, recorder, checkpoint](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
+    Session *session = new Session(config, recorder, next_session_id++,
+                                   checkpoint);
+    ws.setUserData(session);
+    LOG_INFO("Connected!!!");
   });
 
-  h.onDisconnection([&h](uWS::WebSocket<uWS::SERVER> ws, int code, char *message, size_t length) {
+  h.onDisconnection([](uWS::WebSocket<uWS::SERVER> ws, int code, char *message, size_t length) {
+    delete static_cast<Session *>(ws.getUserData());
+    ws.setUserData(nullptr);
     ws.close();
-    std::cout << "Disconnected" << std::endl;
+    LOG_INFO("Disconnected");
   });
+}
+
+// Usage: pid [--threads N] [--port PORT] [--record FILE]
+//            [--log-level debug|info|warn|error|off] [--log-rate N]
+//            [--latency-interval SECONDS] [--target-speed MPH]
+//            [--corner-slowdown MPH_PER_DEG] [--schedule FILE]
+//            [--config FILE] [--twiddle] [--tuner NAME] [--steer pid|mpc]
+//            [--frame-period SECONDS] [--derivative-tau SECONDS]
+//            [--checkpoint FILE] [--resume]
+//
+// With more than one thread every thread runs its own hub listening on the
+// same port with SO_REUSEPORT, and the kernel spreads new connections
+// across them. --record logs every control tick to a binary file that
+// pid_replay can play back. Console output goes through the asynchronous
+// Logger; --log-level debug echoes every reply and --log-rate caps the
+// messages per second per thread. Per-stage latency percentiles are served
+// at /latency and logged every --latency-interval seconds (0 turns it off).
+// /metrics serves counters and per-connection stats in Prometheus format.
+// --schedule loads steering gains interpolated by speed, which allows a
+// higher --target-speed than the fixed gains, as does --steer mpc.
+// --config reads the controller parameters from a JSON file (see config.h)
+// and reloads it whenever it changes; running sessions pick up the new
+// values between ticks. Flags given on the command line take precedence
+// over the file, including after a reload. --twiddle tunes the steering
+// gains online on every connection, with classic Twiddle or the --tuner
+// backend (nelder-mead, cma-es or bayes). --checkpoint saves the tuner
+// state to FILE after every episode; a connection that drops hands it to
+// the next one, and --resume picks it up from an earlier run.
+// --frame-period is the frame period the gains were tuned at and
+// --derivative-tau the steering derivative filter applied to frames that
+// arrive early or late (see Controller::SetTiming).
+int main(int argc, char *argv[])
+{
+  int threads = 1;
+  std::string record_path;
+  std::string config_path;
+  std::string checkpoint_path;
+  bool resume = false;
+  LogLevel log_level;
+  int latency_interval = 60;
+  json overrides = json::object();
 
-  int port = 4567;
-  if (h.listen(port))
-  {
-    std::cout << "Listening to port " << port << std::endl;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--port") && i + 1 < argc) {
+      overrides["port"] = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (!strcmp(argv[i], "--log-level") && i + 1 < argc &&
+               Logger::ParseLevel(argv[i + 1], &log_level)) {
+      Logger::Get().SetLevel(log_level);
+      ++i;
+    } else if (!strcmp(argv[i], "--log-rate") && i + 1 < argc) {
+      Logger::Get().SetRateLimit(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--latency-interval") && i + 1 < argc) {
+      latency_interval = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--target-speed") && i + 1 < argc) {
+      overrides["target_speed"] = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--corner-slowdown") && i + 1 < argc) {
+      overrides["corner_slowdown"] = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--schedule") && i + 1 < argc) {
+      overrides["steer_schedule"] = argv[++i];
+    } else if (!strcmp(argv[i], "--config") && i + 1 < argc) {
+      config_path = argv[++i];
+    } else if (!strcmp(argv[i], "--twiddle")) {
+      overrides["twiddle"]["enabled"] = true;
+    } else if (!strcmp(argv[i], "--tuner") && i + 1 < argc) {
+      overrides["twiddle"]["enabled"] = true;
+      overrides["twiddle"]["tuner"] = argv[++i];
+    } else if (!strcmp(argv[i], "--steer") && i + 1 < argc) {
+      overrides["steer_mode"] = argv[++i];
+    } else if (!strcmp(argv[i], "--frame-period") && i + 1 < argc) {
+      overrides["frame_period"] = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--derivative-tau") && i + 1 < argc) {
+      overrides["steer_derivative_tau"] = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--checkpoint") && i + 1 < argc) {
+      checkpoint_path = argv[++i];
+    } else if (!strcmp(argv[i], "--resume")) {
+      resume = true;
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--threads N] [--port PORT] [--record FILE]"
+                << " [--log-level LEVEL] [--log-rate N]"
+                << " [--latency-interval SECONDS] [--target-speed MPH]"
+                << " [--corner-slowdown MPH_PER_DEG] [--schedule FILE]"
+                << " [--config FILE] [--twiddle] [--tuner NAME]"
+                << " [--steer pid|mpc] [--frame-period SECONDS]"
+                << " [--derivative-tau SECONDS] [--checkpoint FILE] [--resume]"
+                << std::endl;
+      return -1;
+    }
   }
-  else
-  {
-    std::cerr << "Failed to listen to port" << std::endl;
+
+  const std::string cli = overrides.empty() ? "" : overrides.dump();
+  ControllerConfig initial;
+  std::string error;
+  if (!LoadConfig(config_path, cli, &initial, &error)) {
+    std::cerr << error << std::endl;
     return -1;
   }
-  h.run();
+  const int port = initial.port;
+  ConfigStore config(initial);
+  ConfigWatcher watcher;
+  if (!config_path.empty() && !watcher.Start(config_path, cli, &config, &error)) {
+    std::cerr << error << std::endl;
+    return -1;
+  }
+  if (threads < 1) threads = 1;
+  const int options = threads > 1 ? uS::ListenOptions::REUSE_PORT : 0;
+
+  TelemetryRecorder recorder;
+  if (!record_path.empty() && !recorder.Open(record_path)) {
+    std::cerr << "Failed to open " << record_path << std::endl;
+    return -1;
+  }
+  TelemetryRecorder *record = record_path.empty() ? nullptr : &recorder;
+
+  Checkpoint checkpoint;
+  if (resume && checkpoint_path.empty()) {
+    std::cerr << "--resume needs --checkpoint FILE" << std::endl;
+    return -1;
+  }
+  if (!checkpoint_path.empty() &&
+      !checkpoint.Open(checkpoint_path, resume, &error)) {
+    std::cerr << error << std::endl;
+    return -1;
+  }
+  Checkpoint *tuner_checkpoint = checkpoint_path.empty() ? nullptr : &checkpoint;
+
+  // Bind every listener before running any loop so a failure is reported
+  // up front.
+  std::vector<uWS::Hub *> hubs;
+  for (int i = 0; i < threads; ++i) {
+    uWS::Hub *h = new uWS::Hub();
+    ConfigureHub(*h, &config, record, tuner_checkpoint);
+    if (!h->listen(port, nullptr, options))
+    {
+      std::cerr << "Failed to listen to port" << std::endl;
+      return -1;
+    }
+    hubs.push_back(h);
+  }
+  std::cout << "Listening to port " << port << " on " << threads
+            << (threads > 1 ? " threads" : " thread") << std::endl;
+
+  std::vector<std::thread> workers;
+  if (latency_interval > 0) {
+    workers.push_back(std::thread([latency_interval] {
+      for (;;) {
+        std::this_thread::sleep_for(std::chrono::seconds(latency_interval));
+        // One message per line, log messages are limited in length.
+        std::string summary = LatencyStats::Get().Summary();
+        size_t begin = 0, end;
+        while ((end = summary.find('\n', begin)) != std::string::npos) {
+          LOG_INFO("%s", summary.substr(begin, end - begin).c_str());
+          begin = end + 1;
+        }
+      }
+    }));
+  }
+  for (int i = 1; i < threads; ++i) {
+    workers.push_back(std::thread([hubs, i] { hubs[i]->run(); }));
+  }
+  hubs[0]->run();
+  for (auto &w : workers) w.join();
 }
@@ -0,0 +1,138 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <math.h>
+#include "latency.h"
+
+SessionStats::SessionStats(uint32_t id)
+    : id(id), frames(0), cte_sq_sum(0), twiddle_episodes(0),
+      twiddle_stopped(0), twiddle_best(0), twiddle_dp_sum(0) {}
+
+Metrics &Metrics::Get() {
+  static Metrics metrics;
+  return metrics;
+}
+
+Metrics::Metrics() : next_slot_(0), last_frames_(0), last_render_ns_(0) {
+  for (size_t i = 0; i < kSlots; ++i) {
+    for (int c = 0; c < static_cast<int>(Counter::kCount); ++c) {
+      slots_[i].counts[c].store(0);
+    }
+  }
+}
+
+Metrics::Slot &Metrics::LocalSlot() {
+  // Threads beyond kSlots share slots, which stays correct because the
+  // scraper only reads; only an increment racing on a shared slot is lost.
+  static thread_local Slot *slot = nullptr;
+  if (!slot) slot = &slots_[next_slot_.fetch_add(1) % kSlots];
+  return *slot;
+}
+
+uint64_t Metrics::Total(Counter counter) const {
+  uint64_t total = 0;
+  for (size_t i = 0; i < kSlots; ++i) {
+    total += slots_[i].counts[static_cast<int>(counter)].load(
+        std::memory_order_relaxed);
+  }
+  return total;
+}
+
+void Metrics::Register(const SessionStats *stats) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sessions_.push_back(stats);
+}
+
+void Metrics::Unregister(const SessionStats *stats) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sessions_.erase(std::remove(sessions_.begin(), sessions_.end(), stats),
+                  sessions_.end());
+}
+
+namespace {
+
+void Append(std::string &out, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void Append(std::string &out, const char *format, ...) {
+  char line[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  out += line;
+}
+
+} // namespace
+
+std::string Metrics::Render() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string out;
+
+  uint64_t frames = Total(Counter::kFrames);
+  uint64_t now = LatencyNow();
+  double fps = 0;
+  if (last_render_ns_ && now > last_render_ns_) {
+    fps = (frames - last_frames_) * 1e9 / (now - last_render_ns_);
+  }
+  last_frames_ = frames;
+  last_render_ns_ = now;
+
+  Append(out, "# TYPE pid_frames_total counter\npid_frames_total %llu\n",
+         static_cast<unsigned long long>(frames));
+  Append(out, "# HELP pid_frames_per_second Frame rate since the previous scrape.\n"
+              "# TYPE pid_frames_per_second gauge\npid_frames_per_second %g\n",
+         fps);
+  Append(out, "# TYPE pid_parse_failures_total counter\n"
+              "pid_parse_failures_total %llu\n",
+         static_cast<unsigned long long>(Total(Counter::kParseFailures)));
+  Append(out, "# TYPE pid_saturated_total counter\n"
+              "pid_saturated_total{actuator=\"steering\"} %llu\n"
+              "pid_saturated_total{actuator=\"throttle\"} %llu\n",
+         static_cast<unsigned long long>(Total(Counter::kSteerSaturated)),
+         static_cast<unsigned long long>(Total(Counter::kThrottleSaturated)));
+
+  out += "# TYPE pid_connections gauge\n";
+  Append(out, "pid_connections %zu\n", sessions_.size());
+  out += "# TYPE pid_cte_rms gauge\n";
+  for (const SessionStats *s : sessions_) {
+    uint64_t n = s->frames.load(std::memory_order_relaxed);
+    double sum = s->cte_sq_sum.load(std::memory_order_relaxed);
+    Append(out, "pid_cte_rms{session=\"%u\"} %g\n", s->id,
+           n ? sqrt(sum / n) : 0.0);
+  }
+  out += "# TYPE pid_twiddle_episodes_total counter\n";
+  for (const SessionStats *s : sessions_) {
+    Append(out, "pid_twiddle_episodes_total{session=\"%u\"} %llu\n", s->id,
+           static_cast<unsigned long long>(s->twiddle_episodes.load()));
+  }
+  out += "# TYPE pid_twiddle_stopped_total counter\n";
+  for (const SessionStats *s : sessions_) {
+    Append(out, "pid_twiddle_stopped_total{session=\"%u\"} %llu\n", s->id,
+           static_cast<unsigned long long>(s->twiddle_stopped.load()));
+  }
+  out += "# TYPE pid_twiddle_best_error gauge\n";
+  for (const SessionStats *s : sessions_) {
+    Append(out, "pid_twiddle_best_error{session=\"%u\"} %g\n", s->id,
+           s->twiddle_best.load());
+  }
+  out += "# TYPE pid_twiddle_delta_sum gauge\n";
+  for (const SessionStats *s : sessions_) {
+    Append(out, "pid_twiddle_delta_sum{session=\"%u\"} %g\n", s->id,
+           s->twiddle_dp_sum.load());
+  }
+
+  LatencyHistogram &total = LatencyStats::Get()[Stage::kTotal];
+  out += "# TYPE pid_loop_latency_seconds summary\n";
+  const double quantiles[] = { 0.5, 0.99, 0.999 };
+  for (double q : quantiles) {
+    Append(out, "pid_loop_latency_seconds{quantile=\"%g\"} %g\n", q,
+           total.Percentile(q) * 1e-9);
+  }
+  Append(out, "pid_loop_latency_seconds_count %llu\n",
+         static_cast<unsigned long long>(total.Count()));
+  Append(out, "# TYPE pid_loop_latency_max_seconds gauge\n"
+              "pid_loop_latency_max_seconds %g\n", total.Max() * 1e-9);
+  return out;
+}
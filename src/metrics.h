@@ -0,0 +1,91 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+* Process-wide event counters.
+*/
+enum class Counter {
+  kFrames,             // telemetry frames handled
+  kParseFailures,      // frames ParseTelemetry rejected
+  kSteerSaturated,     // |steering| at or above kSteerSaturation
+  kThrottleSaturated,  // throttle at the [-1, 1] limit
+  kCount
+};
+
+// Steering is squashed into (-1, 1), so it never reaches the limit exactly.
+const double kSteerSaturation = 0.95;
+
+/*
+* Live statistics of one connection. Only the owning hub thread writes,
+* the scraper only reads, so relaxed atomics are enough.
+*/
+struct SessionStats {
+  uint32_t id;
+  std::atomic<uint64_t> frames;
+  std::atomic<double> cte_sq_sum;
+  std::atomic<uint64_t> twiddle_episodes;
+  std::atomic<uint64_t> twiddle_stopped;   // episodes cut short
+  std::atomic<double> twiddle_best;
+  std::atomic<double> twiddle_dp_sum;
+
+  explicit SessionStats(uint32_t id);
+};
+
+/*
+* Metrics served as Prometheus text at /metrics. Counters live in per-thread
+* slots padded to a cache line each, so control threads never write to a
+* shared line and a scrape only reads them.
+*/
+class Metrics {
+public:
+  static const size_t kSlots = 64;
+
+  static Metrics &Get();
+
+  /*
+  * Add one to a counter in the calling thread's slot.
+  */
+  void Increment(Counter counter) {
+    std::atomic<uint64_t> &c = LocalSlot().counts[static_cast<int>(counter)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  uint64_t Total(Counter counter) const;
+
+  /*
+  * Sessions register for the lifetime of their connection. Only connect,
+  * disconnect and scrapes take the registry lock.
+  */
+  void Register(const SessionStats *stats);
+  void Unregister(const SessionStats *stats);
+
+  /*
+  * Prometheus text exposition of all metrics.
+  */
+  std::string Render();
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> counts[static_cast<int>(Counter::kCount)];
+  };
+
+  Metrics();
+  Slot &LocalSlot();
+
+  Slot slots_[kSlots];
+  std::atomic<size_t> next_slot_;
+
+  std::mutex mutex_;
+  std::vector<const SessionStats *> sessions_;
+  uint64_t last_frames_;
+  uint64_t last_render_ns_;
+};
+
+#endif /* METRICS_H */
@@ -0,0 +1,229 @@
+#include "mpc.h"
+#include <math.h>
+
+namespace {
+
+const double kMphPerMps = 2.23694;
+
+// Keeps the QP strictly convex when standing still.
+const double kMinCurvature = 1e-9;
+
+double Clamp(double x, double lo, double hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+
+} // namespace
+
+MpcSteer::MpcSteer() {
+  Reset();
+}
+
+void MpcSteer::Reset() {
+
+  primed_ = false;
+  cte_ = 0;
+  rate_ = 0;
+  accel_ = 0;
+  applied_ = 0;
+  iterations_ = 0;
+  for (int i = 0; i < kHorizon; ++i) plan_[i] = 0;
+}
+
+double MpcSteer::Update(double cte, double speed, double dt) {
+
+  if (dt <= 0) dt = params.step;
+  double v = speed / kMphPerMps;
+  // Lateral acceleration per unit of steering command.
+  double gain = v * v / params.wheelbase * params.max_steer * M_PI / 180;
+
+  Observe(cte, v, gain, dt);
+
+  // Warm start: the previous plan, one step on.
+  for (int i = 0; i + 1 < kHorizon; ++i) plan_[i] = plan_[i + 1];
+
+  BuildQp(gain);
+  Solve();
+  applied_ = plan_[0];
+  return applied_;
+}
+
+void MpcSteer::Observe(double cte, double v, double gain, double dt) {
+
+  if (!primed_) {
+    primed_ = true;
+    cte_ = cte;
+    return;
+  }
+
+  // Predict with the command applied over the last frame, then correct
+  // with critically damped alpha-beta-gamma gains.
+  double a = gain * applied_ + accel_;
+  double predicted = cte_ + dt * rate_ + 0.5 * dt * dt * a;
+  double residual = cte - predicted;
+  double t = params.smoothing;
+  double alpha = 1 - t * t * t;
+  double beta = 1.5 * (1 - t * t) * (1 - t);
+  double gamma = 0.5 * (1 - t) * (1 - t) * (1 - t);
+  cte_ = predicted + alpha * residual;
+  rate_ += dt * a + beta * residual / dt;
+  accel_ += 2 * gamma * residual / (dt * dt);
+
+  // At low speed the residuals are mostly noise. The car cannot move
+  // sideways faster than it drives, and a curve tighter than full lock
+  // cannot be followed anyway.
+  rate_ = Clamp(rate_, -v, v);
+  accel_ = Clamp(accel_, -gain, gain);
+}
+
+void MpcSteer::BuildQp(double gain) {
+
+  const int n = kHorizon;
+  const double h = params.step;
+  const double rate_gain = h * gain;
+
+  // cte and its rate j steps ahead with no steering, and the cte response
+  // j steps after a unit command held for one step.
+  impulse_[0] = 0;
+  free_cte_[0] = cte_;
+  free_rate_[0] = rate_;
+  for (int j = 1; j <= n; ++j) {
+    double t = j * h;
+    impulse_[j] = h * h * (j - 0.5) * gain;
+    free_cte_[j] = cte_ + t * rate_ + 0.5 * t * t * accel_;
+    free_rate_[j] = rate_ + t * accel_;
+  }
+
+  // Sum over the horizon of impulse products; each diagonal is built from
+  // its far end, E[a][b] = E[a + 1][b + 1] + c[n - a] c[n - b].
+  for (int d = 0; d < n; ++d) {
+    double sum = 0;
+    for (int a = n - 1 - d; a >= 0; --a) {
+      int b = a + d;
+      sum += impulse_[n - a] * impulse_[n - b];
+      double rate_term = (n - b) * rate_gain * rate_gain;
+      double value = params.q_cte * sum + params.q_rate * rate_term;
+      h_[a][b] = value;
+      h_[b][a] = value;
+    }
+  }
+  // Penalties on the lateral acceleration and its change, so the balance
+  // with the tracking terms does not depend on speed.
+  const double gain2 = gain * gain;
+  const double r_steer = params.r_steer * gain2 + kMinCurvature;
+  const double r_change = params.r_change * gain2;
+  for (int i = 0; i < n; ++i) {
+    h_[i][i] += r_steer + (i + 1 < n ? 2 : 1) * r_change;
+    if (i + 1 < n) {
+      h_[i][i + 1] -= r_change;
+      h_[i + 1][i] -= r_change;
+    }
+  }
+
+  for (int i = 0; i < n; ++i) {
+    double cte_term = 0;
+    double rate_term = 0;
+    for (int j = i + 1; j <= n; ++j) {
+      cte_term += impulse_[j - i] * free_cte_[j];
+      rate_term += free_rate_[j];
+    }
+    g_[i] = params.q_cte * cte_term + params.q_rate * rate_gain * rate_term;
+  }
+  g_[0] -= r_change * applied_;
+}
+
+void MpcSteer::Solve() {
+
+  // Primal active set on 1/2 u'Hu + g'u with |u| <= 1, starting from the
+  // warm start clamped to the box. The plan stays feasible and the cost
+  // never rises, so stopping at the cap still gives a usable command.
+  const int n = kHorizon;
+  for (int i = 0; i < n; ++i) {
+    plan_[i] = Clamp(plan_[i], -1, 1);
+    bound_[i] = fabs(plan_[i]) < 1 ? 0 : (plan_[i] > 0 ? 1 : -1);
+  }
+
+  int it = 0;
+  while (it < kMaxIterations) {
+    ++it;
+    int n_free = 0;
+    for (int i = 0; i < n; ++i) {
+      if (!bound_[i]) free_[n_free++] = i;
+    }
+    if (!SolveFree(n_free)) break;
+
+    // Move towards the minimizer over the free commands, stopping at the
+    // first bound in the way.
+    double step = 1;
+    int blocking = -1;
+    for (int a = 0; a < n_free; ++a) {
+      double u = plan_[free_[a]];
+      double d = rhs_[a] - u;
+      double limit = d > 0 ? (1 - u) / d : (d < 0 ? (-1 - u) / d : 1);
+      if (limit < step) {
+        step = limit;
+        blocking = free_[a];
+      }
+    }
+    for (int a = 0; a < n_free; ++a) {
+      double u = plan_[free_[a]];
+      plan_[free_[a]] = u + step * (rhs_[a] - u);
+    }
+    if (blocking >= 0) {
+      bound_[blocking] = plan_[blocking] > 0 ? 1 : -1;
+      plan_[blocking] = bound_[blocking];
+      continue;
+    }
+
+    // Optimal over the free set: release the bound whose gradient pulls
+    // hardest back into the box, if any.
+    int release = -1;
+    double pull = 0;
+    for (int i = 0; i < n; ++i) {
+      if (!bound_[i]) continue;
+      double grad = g_[i];
+      for (int j = 0; j < n; ++j) grad += h_[i][j] * plan_[j];
+      if (grad * bound_[i] > pull) {
+        pull = grad * bound_[i];
+        release = i;
+      }
+    }
+    if (release < 0) break;
+    bound_[release] = 0;
+  }
+  iterations_ = it;
+}
+
+bool MpcSteer::SolveFree(int n_free) {
+
+  // H_FF u_F = -(g_F + H_FB u_B) by Cholesky of H_FF, solution in rhs_.
+  for (int a = 0; a < n_free; ++a) {
+    int i = free_[a];
+    double r = -g_[i];
+    for (int j = 0; j < kHorizon; ++j) {
+      if (bound_[j]) r -= h_[i][j] * plan_[j];
+    }
+    rhs_[a] = r;
+    for (int b = 0; b <= a; ++b) {
+      double sum = h_[i][free_[b]];
+      for (int k = 0; k < b; ++k) sum -= l_[a][k] * l_[b][k];
+      if (b < a) {
+        l_[a][b] = sum / l_[b][b];
+      } else if (sum > 0) {
+        l_[a][a] = sqrt(sum);
+      } else {
+        return false;
+      }
+    }
+  }
+  for (int a = 0; a < n_free; ++a) {
+    double sum = rhs_[a];
+    for (int k = 0; k < a; ++k) sum -= l_[a][k] * rhs_[k];
+    rhs_[a] = sum / l_[a][a];
+  }
+  for (int a = n_free - 1; a >= 0; --a) {
+    double sum = rhs_[a];
+    for (int k = a + 1; k < n_free; ++k) sum -= l_[k][a] * rhs_[k];
+    rhs_[a] = sum / l_[a][a];
+  }
+  return true;
+}
@@ -0,0 +1,91 @@
+#ifndef MPC_H
+#define MPC_H
+
+/*
+* Model predictive steering. The simulator reports no waypoints, so the
+* model is the lateral error dynamics of a kinematic bicycle at the
+* measured speed, linearized around the centerline:
+*
+*   cte'' = v^2 / wheelbase * max_steer * u + w
+*
+* with u the steering command in [-1, 1] and w the lateral acceleration
+* the road adds, e.g. in a curve. An alpha-beta-gamma observer estimates
+* cte, its rate and w from the reported cte. Every tick the steering over
+* the next kHorizon steps is chosen to minimize
+*
+*   sum q_cte cte^2 + q_rate cte'^2 + r_steer u^2 + r_change (du)^2
+*
+* subject to |u| <= 1, a dense box constrained QP. It is solved with a
+* primal active set method warm started from the previous plan: the
+* commands not held at +-1 are solved exactly by Cholesky, and one bound
+* is added or released per iteration, which usually ends after one or two
+* iterations. Iterations are capped at kMaxIterations (each about
+* kHorizon^3 / 6 multiply-adds); the plan is feasible and no worse than
+* the warm start at every iteration, so it is used as is if the cap is
+* reached. All storage is inside the object.
+*/
+class MpcSteer {
+public:
+  static const int kHorizon = 20;
+  static const int kMaxIterations = 8;
+
+  struct Params {
+    double wheelbase;   // meters
+    double max_steer;   // wheel angle at u = 1, degrees
+    double step;        // seconds between horizon points
+    double q_cte;       // weights of the cost above
+    double q_rate;
+    double r_steer;
+    double r_change;
+    double smoothing;   // observer pole in (0, 1), larger filters more
+    Params() : wheelbase(2.67), max_steer(25), step(0.05), q_cte(1),
+               q_rate(0.1), r_steer(1e-6), r_change(1e-4), smoothing(0.5) {}
+  };
+
+  Params params;
+
+  MpcSteer();
+
+  /*
+  * Forget the observer state and the previous plan.
+  */
+  void Reset();
+
+  /*
+  * Steering command in [-1, 1] for a cte in meters and a speed in mph, dt
+  * seconds after the previous call (the horizon step when dt <= 0).
+  */
+  double Update(double cte, double speed, double dt);
+
+  /*
+  * Last command returned by Update, and the active set iterations it took.
+  */
+  double steering() const { return plan_[0]; }
+  int iterations() const { return iterations_; }
+
+private:
+  bool primed_;
+  double cte_;        // observer state
+  double rate_;
+  double accel_;
+  double applied_;    // command applied since the previous tick
+  int iterations_;
+
+  double plan_[kHorizon];
+  double h_[kHorizon][kHorizon];
+  double g_[kHorizon];
+  signed char bound_[kHorizon];   // -1 or +1 when held at a bound, else 0
+  int free_[kHorizon];
+  double l_[kHorizon][kHorizon];  // Cholesky factor of the free block
+  double rhs_[kHorizon];          // minimizer over the free commands
+  double impulse_[kHorizon + 1];  // cte response to a unit u, by delay
+  double free_cte_[kHorizon + 1];
+  double free_rate_[kHorizon + 1];
+
+  void Observe(double cte, double v, double gain, double dt);
+  void BuildQp(double gain);
+  void Solve();
+  bool SolveFree(int n_free);
+};
+
+#endif /* MPC_H */
@@ -0,0 +1,214 @@
+#include "output_shaping.h"
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+* The vector paths perform exactly the operations of the scalar functions in
+* shaping::, in the same order, so results match bit for bit. Clamp(x, lo,
+* hi) maps to min(hi, max(lo, x)), which keeps NaN like the scalar form.
+* AVX has no 256 bit integer ops, so PolySigmoid builds 2^k in two SSE2
+* halves there.
+*/
+
+namespace {
+
+using namespace shaping;
+
+template <double (*Shape)(double)>
+void Apply(const double *in, double *out, size_t k, size_t n) {
+  for (; k < n; ++k) {
+    out[k] = Shape(in[k]);
+  }
+}
+
+#if defined(__SSE2__)
+// 2^k from shifted = k + kRound, see shaping::PolySigmoid.
+inline __m128i ScaleBits(__m128d shifted) {
+  uint64_t round_bits;
+  memcpy(&round_bits, &kRound, sizeof(round_bits));
+  const __m128i bias = _mm_set1_epi64x(round_bits - 1023);
+  return _mm_slli_epi64(_mm_sub_epi64(_mm_castpd_si128(shifted), bias), 52);
+}
+#endif
+
+#if defined(__AVX__)
+
+inline __m256d Clamp4(__m256d x, double lo, double hi) {
+  return _mm256_min_pd(_mm256_set1_pd(hi),
+                       _mm256_max_pd(_mm256_set1_pd(lo), x));
+}
+
+size_t HardClampVector(const double *in, double *out, size_t n) {
+  size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    _mm256_storeu_pd(out + k, Clamp4(_mm256_loadu_pd(in + k), -1, 1));
+  }
+  return k;
+}
+
+size_t RationalTanhVector(const double *in, double *out, size_t n) {
+  const __m256d half = _mm256_set1_pd(0.5);
+  size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    __m256d y = Clamp4(_mm256_mul_pd(half, _mm256_loadu_pd(in + k)),
+                       -kTanhLimit, kTanhLimit);
+    __m256d y2 = _mm256_mul_pd(y, y);
+    __m256d num = _mm256_add_pd(y2, _mm256_set1_pd(378));
+    num = _mm256_add_pd(_mm256_mul_pd(num, y2), _mm256_set1_pd(17325));
+    num = _mm256_add_pd(_mm256_mul_pd(num, y2), _mm256_set1_pd(135135));
+    __m256d den = _mm256_mul_pd(_mm256_set1_pd(28), y2);
+    den = _mm256_add_pd(den, _mm256_set1_pd(3150));
+    den = _mm256_add_pd(_mm256_mul_pd(den, y2), _mm256_set1_pd(62370));
+    den = _mm256_add_pd(_mm256_mul_pd(den, y2), _mm256_set1_pd(135135));
+    __m256d v = _mm256_div_pd(_mm256_mul_pd(y, num), den);
+    _mm256_storeu_pd(out + k, Clamp4(v, -1, 1));
+  }
+  return k;
+}
+
+size_t PolySigmoidVector(const double *in, double *out, size_t n) {
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  const __m256d round = _mm256_set1_pd(kRound);
+  const __m256d one = _mm256_set1_pd(1);
+  const double coeffs[] = { 1.0 / 720, 1.0 / 120, 1.0 / 24, 1.0 / 6, 0.5,
+                            1, 1 };
+  size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    __m256d x = _mm256_loadu_pd(in + k);
+    __m256d a = Clamp4(_mm256_andnot_pd(sign, x), 0, kExpLimit);
+    __m256d t = _mm256_mul_pd(a, _mm256_set1_pd(-kLog2e));
+    __m256d shifted = _mm256_add_pd(t, round);
+    __m256d r = _mm256_mul_pd(_mm256_sub_pd(t, _mm256_sub_pd(shifted, round)),
+                              _mm256_set1_pd(kLn2));
+    __m256d p = _mm256_set1_pd(1.0 / 5040);
+    for (double c : coeffs) {
+      p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(c));
+    }
+    __m128i lo = ScaleBits(_mm256_castpd256_pd128(shifted));
+    __m128i hi = ScaleBits(_mm256_extractf128_pd(shifted, 1));
+    __m256d scale = _mm256_insertf128_pd(
+        _mm256_castpd128_pd256(_mm_castsi128_pd(lo)), _mm_castsi128_pd(hi), 1);
+    __m256d e = _mm256_mul_pd(p, scale);
+    __m256d v = _mm256_div_pd(_mm256_sub_pd(one, e), _mm256_add_pd(one, e));
+    v = _mm256_or_pd(v, _mm256_and_pd(sign, x));
+    _mm256_storeu_pd(out + k, v);
+  }
+  return k;
+}
+
+#elif defined(__SSE2__)
+
+inline __m128d Clamp2(__m128d x, double lo, double hi) {
+  return _mm_min_pd(_mm_set1_pd(hi), _mm_max_pd(_mm_set1_pd(lo), x));
+}
+
+size_t HardClampVector(const double *in, double *out, size_t n) {
+  size_t k = 0;
+  for (; k + 2 <= n; k += 2) {
+    _mm_storeu_pd(out + k, Clamp2(_mm_loadu_pd(in + k), -1, 1));
+  }
+  return k;
+}
+
+size_t RationalTanhVector(const double *in, double *out, size_t n) {
+  const __m128d half = _mm_set1_pd(0.5);
+  size_t k = 0;
+  for (; k + 2 <= n; k += 2) {
+    __m128d y = Clamp2(_mm_mul_pd(half, _mm_loadu_pd(in + k)),
+                       -kTanhLimit, kTanhLimit);
+    __m128d y2 = _mm_mul_pd(y, y);
+    __m128d num = _mm_add_pd(y2, _mm_set1_pd(378));
+    num = _mm_add_pd(_mm_mul_pd(num, y2), _mm_set1_pd(17325));
+    num = _mm_add_pd(_mm_mul_pd(num, y2), _mm_set1_pd(135135));
+    __m128d den = _mm_mul_pd(_mm_set1_pd(28), y2);
+    den = _mm_add_pd(den, _mm_set1_pd(3150));
+    den = _mm_add_pd(_mm_mul_pd(den, y2), _mm_set1_pd(62370));
+    den = _mm_add_pd(_mm_mul_pd(den, y2), _mm_set1_pd(135135));
+    __m128d v = _mm_div_pd(_mm_mul_pd(y, num), den);
+    _mm_storeu_pd(out + k, Clamp2(v, -1, 1));
+  }
+  return k;
+}
+
+size_t PolySigmoidVector(const double *in, double *out, size_t n) {
+  const __m128d sign = _mm_set1_pd(-0.0);
+  const __m128d round = _mm_set1_pd(kRound);
+  const __m128d one = _mm_set1_pd(1);
+  const double coeffs[] = { 1.0 / 720, 1.0 / 120, 1.0 / 24, 1.0 / 6, 0.5,
+                            1, 1 };
+  size_t k = 0;
+  for (; k + 2 <= n; k += 2) {
+    __m128d x = _mm_loadu_pd(in + k);
+    __m128d a = Clamp2(_mm_andnot_pd(sign, x), 0, kExpLimit);
+    __m128d t = _mm_mul_pd(a, _mm_set1_pd(-kLog2e));
+    __m128d shifted = _mm_add_pd(t, round);
+    __m128d r = _mm_mul_pd(_mm_sub_pd(t, _mm_sub_pd(shifted, round)),
+                           _mm_set1_pd(kLn2));
+    __m128d p = _mm_set1_pd(1.0 / 5040);
+    for (double c : coeffs) {
+      p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(c));
+    }
+    __m128d e = _mm_mul_pd(p, _mm_castsi128_pd(ScaleBits(shifted)));
+    __m128d v = _mm_div_pd(_mm_sub_pd(one, e), _mm_add_pd(one, e));
+    v = _mm_or_pd(v, _mm_and_pd(sign, x));
+    _mm_storeu_pd(out + k, v);
+  }
+  return k;
+}
+
+#else
+
+size_t HardClampVector(const double *, double *, size_t) { return 0; }
+size_t RationalTanhVector(const double *, double *, size_t) { return 0; }
+size_t PolySigmoidVector(const double *, double *, size_t) { return 0; }
+
+#endif
+
+} // namespace
+
+void ShapeSteerBatch(SteerShape shape, const double *in, double *out,
+                     size_t n) {
+  switch (shape) {
+  case SteerShape::kClamp:
+    Apply<HardClamp>(in, out, HardClampVector(in, out, n), n);
+    break;
+  case SteerShape::kRationalTanh:
+    Apply<RationalTanh>(in, out, RationalTanhVector(in, out, n), n);
+    break;
+  case SteerShape::kPolySigmoid:
+    Apply<PolySigmoid>(in, out, PolySigmoidVector(in, out, n), n);
+    break;
+  case SteerShape::kSigmoid:
+  default:
+    Apply<Sigmoid>(in, out, 0, n);
+    break;
+  }
+}
+
+const char *SteerShapeName(SteerShape shape) {
+  switch (shape) {
+  case SteerShape::kClamp:        return "clamp";
+  case SteerShape::kRationalTanh: return "rational";
+  case SteerShape::kPolySigmoid:  return "poly";
+  case SteerShape::kSigmoid:
+  default:                        return "sigmoid";
+  }
+}
+
+bool ParseSteerShape(const char *name, SteerShape *shape) {
+  const SteerShape kShapes[] = { SteerShape::kSigmoid, SteerShape::kClamp,
+                                 SteerShape::kRationalTanh,
+                                 SteerShape::kPolySigmoid };
+  for (SteerShape s : kShapes) {
+    if (!strcmp(name, SteerShapeName(s))) {
+      *shape = s;
+      return true;
+    }
+  }
+  return false;
+}
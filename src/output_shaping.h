@@ -0,0 +1,126 @@
+#ifndef OUTPUT_SHAPING_H
+#define OUTPUT_SHAPING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+
+/*
+* Output shaping stage that bounds the raw steering PID output to [-1, 1].
+* The original law is 2 / (1 + exp(-x)) - 1, which equals tanh(x / 2); the
+* other shapes approximate it without a libm call. Max errors are absolute,
+* measured against the exact expression over x in [-20, 20] by
+* bench_output_shaping:
+*
+*   kSigmoid       exact, one exp() per call
+*   kClamp         hard clamp of x to [-1, 1], not an approximation
+*   kRationalTanh  [7/6] Pade approximant of tanh, max error 9.6e-5
+*   kPolySigmoid   exp(-|x|) from range reduction and a degree 7
+*                  polynomial, max error 3.5e-9
+*
+* All shapes are odd, monotonic and branch free. The batch form runs the
+* approximations with SSE2 or AVX and matches the scalar form bit for bit.
+*/
+enum class SteerShape {
+  kSigmoid,
+  kClamp,
+  kRationalTanh,
+  kPolySigmoid
+};
+
+namespace shaping {
+
+const double kTanhLimit = 4.97;           // |y| where the Pade form hits 1
+const double kExpLimit = 40;              // exp(-40) is below double epsilon
+const double kLog2e = 1.4426950408889634;
+const double kLn2 = 0.6931471805599453;
+const double kRound = 6755399441055744.0; // 1.5 * 2^52, rounds to integer
+
+inline double Clamp(double x, double lo, double hi) {
+  x = x < lo ? lo : x;
+  return x > hi ? hi : x;
+}
+
+inline double Sigmoid(double x) {
+  return 2 / (1 + exp(-x)) - 1;
+}
+
+inline double HardClamp(double x) {
+  return Clamp(x, -1, 1);
+}
+
+/*
+* tanh(y) with y = x / 2. The approximant crosses 1 at |y| = 4.9718, so y
+* is clamped just below that and the result to [-1, 1].
+*/
+inline double RationalTanh(double x) {
+  double y = Clamp(0.5 * x, -kTanhLimit, kTanhLimit);
+  double y2 = y * y;
+  double num = ((y2 + 378) * y2 + 17325) * y2 + 135135;
+  double den = ((28 * y2 + 3150) * y2 + 62370) * y2 + 135135;
+  return HardClamp(y * num / den);
+}
+
+/*
+* (1 - e) / (1 + e) with e = exp(-|x|), restoring the sign of x. The
+* exponential is split as 2^k * exp(r) with integer k and |r| <= ln(2) / 2;
+* exp(r) is a Taylor polynomial and 2^k is built directly in the exponent
+* bits.
+*/
+inline double PolySigmoid(double x) {
+  double a = Clamp(fabs(x), 0, kExpLimit);
+  double t = a * -kLog2e;
+  double shifted = t + kRound;
+  double k = shifted - kRound;
+  double r = (t - k) * kLn2;
+  // exp(r) for |r| <= ln(2) / 2, Taylor to degree 7
+  double p = 1.0 / 5040;
+  p = p * r + 1.0 / 720;
+  p = p * r + 1.0 / 120;
+  p = p * r + 1.0 / 24;
+  p = p * r + 1.0 / 6;
+  p = p * r + 0.5;
+  p = p * r + 1;
+  p = p * r + 1;
+  // 2^k from the low mantissa bits of shifted, which hold k
+  uint64_t bits, round_bits;
+  memcpy(&bits, &shifted, sizeof(bits));
+  memcpy(&round_bits, &kRound, sizeof(round_bits));
+  uint64_t scale_bits = (bits - round_bits + 1023) << 52;
+  double scale;
+  memcpy(&scale, &scale_bits, sizeof(scale));
+  double e = p * scale;
+  double v = (1 - e) / (1 + e);
+  return copysign(v, x);
+}
+
+} // namespace shaping
+
+/*
+* Scalar form, used once per tick by Controller.
+*/
+inline double ShapeSteer(SteerShape shape, double x) {
+  switch (shape) {
+  case SteerShape::kClamp:        return shaping::HardClamp(x);
+  case SteerShape::kRationalTanh: return shaping::RationalTanh(x);
+  case SteerShape::kPolySigmoid:  return shaping::PolySigmoid(x);
+  case SteerShape::kSigmoid:
+  default:                        return shaping::Sigmoid(x);
+  }
+}
+
+/*
+* Batch form for multi-controller engines, out[k] = ShapeSteer(shape, in[k])
+* for k < n. The shape is dispatched once; in and out may alias.
+*/
+void ShapeSteerBatch(SteerShape shape, const double *in, double *out, size_t n);
+
+/*
+* Name used on command lines ("sigmoid", "clamp", "rational", "poly") and
+* its inverse. ParseSteerShape returns false for an unknown name.
+*/
+const char *SteerShapeName(SteerShape shape);
+bool ParseSteerShape(const char *name, SteerShape *shape);
+
+#endif /* OUTPUT_SHAPING_H */
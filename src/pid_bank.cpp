@@ -0,0 +1,162 @@
+#include "pid_bank.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+* The vector paths perform exactly the scalar operations of PID, in the same
+* order, so results match bit for bit:
+*   d = cte - p; p = cte; i = i + cte;
+*   total = ((-Kp * p) - Kd * d) - Ki * i
+* AVX handles four controllers per instruction, SSE2 two, and the scalar
+* loop takes the remainder or everything when neither is available.
+*/
+
+namespace {
+
+inline void UpdateScalar(double cte, double &p, double &i, double &d) {
+  d = cte - p;
+  p = cte;
+  i += cte;
+}
+
+inline double TotalScalar(double Kp, double Ki, double Kd, double p,
+                          double i, double d) {
+  return - Kp * p - Kd * d - Ki * i;
+}
+
+} // namespace
+
+PIDBank::PIDBank(size_t n) {
+  Resize(n);
+}
+
+void PIDBank::Resize(size_t n) {
+  p_error.resize(n, 0);
+  i_error.resize(n, 0);
+  d_error.resize(n, 0);
+  Kp.resize(n, 0);
+  Ki.resize(n, 0);
+  Kd.resize(n, 0);
+}
+
+void PIDBank::Init(size_t i, double Kp, double Ki, double Kd) {
+  this->Kp[i] = Kp;
+  this->Ki[i] = Ki;
+  this->Kd[i] = Kd;
+  p_error[i] = 0;
+  i_error[i] = 0;
+  d_error[i] = 0;
+}
+
+void PIDBank::UpdateError(const double *cte) {
+  const size_t n = size();
+  double *p = p_error.data();
+  double *i = i_error.data();
+  double *d = d_error.data();
+  size_t k = 0;
+#if defined(__AVX__)
+  for (; k + 4 <= n; k += 4) {
+    __m256d c = _mm256_loadu_pd(cte + k);
+    _mm256_storeu_pd(d + k, _mm256_sub_pd(c, _mm256_loadu_pd(p + k)));
+    _mm256_storeu_pd(p + k, c);
+    _mm256_storeu_pd(i + k, _mm256_add_pd(_mm256_loadu_pd(i + k), c));
+  }
+#elif defined(__SSE2__)
+  for (; k + 2 <= n; k += 2) {
+    __m128d c = _mm_loadu_pd(cte + k);
+    _mm_storeu_pd(d + k, _mm_sub_pd(c, _mm_loadu_pd(p + k)));
+    _mm_storeu_pd(p + k, c);
+    _mm_storeu_pd(i + k, _mm_add_pd(_mm_loadu_pd(i + k), c));
+  }
+#endif
+  for (; k < n; ++k) {
+    UpdateScalar(cte[k], p[k], i[k], d[k]);
+  }
+}
+
+void PIDBank::TotalError(double *out) const {
+  const size_t n = size();
+  const double *p = p_error.data();
+  const double *i = i_error.data();
+  const double *d = d_error.data();
+  const double *kp = Kp.data();
+  const double *ki = Ki.data();
+  const double *kd = Kd.data();
+  size_t k = 0;
+#if defined(__AVX__)
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  for (; k + 4 <= n; k += 4) {
+    __m256d t = _mm256_mul_pd(_mm256_xor_pd(_mm256_loadu_pd(kp + k), sign),
+                              _mm256_loadu_pd(p + k));
+    t = _mm256_sub_pd(t, _mm256_mul_pd(_mm256_loadu_pd(kd + k),
+                                       _mm256_loadu_pd(d + k)));
+    t = _mm256_sub_pd(t, _mm256_mul_pd(_mm256_loadu_pd(ki + k),
+                                       _mm256_loadu_pd(i + k)));
+    _mm256_storeu_pd(out + k, t);
+  }
+#elif defined(__SSE2__)
+  const __m128d sign = _mm_set1_pd(-0.0);
+  for (; k + 2 <= n; k += 2) {
+    __m128d t = _mm_mul_pd(_mm_xor_pd(_mm_loadu_pd(kp + k), sign),
+                           _mm_loadu_pd(p + k));
+    t = _mm_sub_pd(t, _mm_mul_pd(_mm_loadu_pd(kd + k), _mm_loadu_pd(d + k)));
+    t = _mm_sub_pd(t, _mm_mul_pd(_mm_loadu_pd(ki + k), _mm_loadu_pd(i + k)));
+    _mm_storeu_pd(out + k, t);
+  }
+#endif
+  for (; k < n; ++k) {
+    out[k] = TotalScalar(kp[k], ki[k], kd[k], p[k], i[k], d[k]);
+  }
+}
+
+void PIDBank::Update(const double *cte, double *out) {
+  Update(cte, out, 0, size());
+}
+
+void PIDBank::Update(const double *cte, double *out, size_t begin,
+                     size_t end) {
+  double *p = p_error.data();
+  double *i = i_error.data();
+  double *d = d_error.data();
+  const double *kp = Kp.data();
+  const double *ki = Ki.data();
+  const double *kd = Kd.data();
+  size_t k = begin;
+#if defined(__AVX__)
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  for (; k + 4 <= end; k += 4) {
+    __m256d c = _mm256_loadu_pd(cte + k);
+    __m256d vd = _mm256_sub_pd(c, _mm256_loadu_pd(p + k));
+    __m256d vi = _mm256_add_pd(_mm256_loadu_pd(i + k), c);
+    _mm256_storeu_pd(d + k, vd);
+    _mm256_storeu_pd(p + k, c);
+    _mm256_storeu_pd(i + k, vi);
+    __m256d t = _mm256_mul_pd(_mm256_xor_pd(_mm256_loadu_pd(kp + k), sign), c);
+    t = _mm256_sub_pd(t, _mm256_mul_pd(_mm256_loadu_pd(kd + k), vd));
+    t = _mm256_sub_pd(t, _mm256_mul_pd(_mm256_loadu_pd(ki + k), vi));
+    _mm256_storeu_pd(out + k, t);
+  }
+#elif defined(__SSE2__)
+  const __m128d sign = _mm_set1_pd(-0.0);
+  for (; k + 2 <= end; k += 2) {
+    __m128d c = _mm_loadu_pd(cte + k);
+    __m128d vd = _mm_sub_pd(c, _mm_loadu_pd(p + k));
+    __m128d vi = _mm_add_pd(_mm_loadu_pd(i + k), c);
+    _mm_storeu_pd(d + k, vd);
+    _mm_storeu_pd(p + k, c);
+    _mm_storeu_pd(i + k, vi);
+    __m128d t = _mm_mul_pd(_mm_xor_pd(_mm_loadu_pd(kp + k), sign), c);
+    t = _mm_sub_pd(t, _mm_mul_pd(_mm_loadu_pd(kd + k), vd));
+    t = _mm_sub_pd(t, _mm_mul_pd(_mm_loadu_pd(ki + k), vi));
+    _mm_storeu_pd(out + k, t);
+  }
+#endif
+  for (; k < end; ++k) {
+    UpdateScalar(cte[k], p[k], i[k], d[k]);
+    out[k] = TotalScalar(kp[k], ki[k], kd[k], p[k], i[k], d[k]);
+  }
+}
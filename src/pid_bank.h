@@ -0,0 +1,78 @@
+#ifndef PID_BANK_H
+#define PID_BANK_H
+
+#include <cstddef>
+#include <vector>
+#include "PID.h"
+
+/*
+* N independent PID controllers stored as structure of arrays, so that one
+* call steps all of them with SIMD. Every controller produces bit-identical
+* results to a scalar PID with the same gains and inputs.
+*/
+class PIDBank {
+public:
+  /*
+  * Errors
+  */
+  std::vector<double> p_error;
+  std::vector<double> i_error;
+  std::vector<double> d_error;
+
+  /*
+  * Coefficients
+  */
+  std::vector<double> Kp;
+  std::vector<double> Ki;
+  std::vector<double> Kd;
+
+  /*
+  * Constructor, all gains and errors start at zero.
+  */
+  explicit PIDBank(size_t n = 0);
+
+  /*
+  * Resize the bank, new controllers start at zero.
+  */
+  void Resize(size_t n);
+
+  size_t size() const { return p_error.size(); }
+
+  /*
+  * Initialize controller i, same as PID::Init.
+  */
+  void Init(size_t i, double Kp, double Ki, double Kd);
+
+  /*
+  * Same as PID::UpdateError for every controller, cte holds size() values.
+  */
+  void UpdateError(const double *cte);
+
+  /*
+  * Same as PID::TotalError for every controller, out holds size() values.
+  */
+  void TotalError(double *out) const;
+
+  /*
+  * UpdateError followed by TotalError in a single pass over the arrays.
+  */
+  void Update(const double *cte, double *out);
+
+  /*
+  * Same for controllers [begin, end) only, cte and out are still indexed
+  * from controller 0. Disjoint ranges may be updated from different threads.
+  */
+  void Update(const double *cte, double *out, size_t begin, size_t end);
+
+  /*
+  * Same as PID::Feedback for controller i with back-calculation anti-windup
+  * and the given tracking gain.
+  */
+  void BackCalculate(size_t i, double command, double applied,
+                     double tracking_gain) {
+    i_error[i] = PID::BackCalculate(i_error[i], Ki[i], applied - command,
+                                    tracking_gain);
+  }
+};
+
+#endif /* PID_BANK_H */
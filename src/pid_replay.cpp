@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <math.h>
+#include "controller.h"
+#include "telemetry_log.h"
+
+/*
+* Feeds a recorded telemetry log back through Controller at full speed and
+* compares the commands with the recorded ones. Sessions are replayed with
+* one controller each, using the default gains, so logs taken with online
+* Twiddle enabled will not match. Records flagged kLogTimed are replayed with
+* the frame period recovered from their timestamps. --steer selects the
+* steering law the log was taken with.
+*
+* Usage: pid_replay LOG [--tol T] [--runs N] [--steer pid|mpc]
+*/
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " LOG [--tol T] [--runs N] [--steer pid|mpc]" << std::endl;
+    return -1;
+  }
+  double tol = 1e-12;
+  int runs = 1;
+  Controller base;
+  for (int i = 2; i < argc; ++i) {
+    if (!strcmp(argv[i], "--tol") && i + 1 < argc) {
+      tol = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--steer") && i + 1 < argc &&
+               ParseSteerMode(argv[i + 1], &base.steer_mode)) {
+      ++i;
+    } else {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+
+  TelemetryLog log;
+  if (!log.Open(argv[1])) {
+    std::cerr << "Failed to read " << argv[1] << std::endl;
+    return -1;
+  }
+
+  size_t mismatches = 0;
+  double max_diff = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < runs; ++run) {
+    std::map<uint32_t, Controller> controllers;
+    std::map<uint32_t, uint64_t> last_time;
+    mismatches = 0;
+    max_diff = 0;
+    for (size_t i = 0; i < log.size(); ++i) {
+      const LogRecord &r = log.records()[i];
+      Controller &controller =
+          controllers.insert(std::make_pair(r.session, base)).first->second;
+      Command cmd;
+      if (r.flags & kLogTimed) {
+        auto last = last_time.find(r.session);
+        double dt = last != last_time.end()
+                        ? (r.time_ns - last->second) * 1e-9 : 0;
+        last_time[r.session] = r.time_ns;
+        cmd = controller.Update(r.cte, r.speed, r.steering_angle, dt);
+      } else {
+        cmd = controller.Update(r.cte, r.speed, r.steering_angle);
+      }
+      double diff = fmax(fabs(cmd.steering_angle - r.steer_command),
+                         fabs(cmd.throttle - r.throttle_command));
+      if (diff > max_diff) max_diff = diff;
+      if (diff > tol) ++mismatches;
+    }
+  }
+  double wall = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "Records: " << log.size()
+            << " Mismatches: " << mismatches
+            << " Max diff: " << max_diff << std::endl;
+  std::cout << "Replayed " << log.size() * runs << " ticks in " << wall
+            << " s (" << log.size() * runs / wall << " ticks/s)" << std::endl;
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <math.h>
+#include "controller.h"
+#include "simulator.h"
+#include "telemetry_log.h"
+
+/*
+* Drives the controller around the built-in track without the Unity
+* simulator and reports tracking quality and simulation throughput.
+*
+* Usage: pid_sim [--steps N] [--dt SECONDS] [--runs N] [--noise METERS]
+*                [--seed S] [--record FILE] [--jitter FRACTION] [--timed]
+*                [--target-speed MPH] [--corner-slowdown MPH_PER_DEG]
+*                [--schedule FILE] [--steer pid|mpc]
+*                [--shape sigmoid|clamp|rational|poly]
+*                [--derivative-tau SECONDS]
+* Recording always uses the per-frame update. --derivative-tau sets the
+* steering derivative filter of --timed runs, 0 to turn it off.
+*/
+static int Usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [--steps N] [--dt SECONDS] [--runs N] [--noise METERS]"
+            << " [--seed S] [--record FILE] [--jitter FRACTION] [--timed]"
+            << " [--target-speed MPH] [--corner-slowdown MPH_PER_DEG]"
+            << " [--schedule FILE] [--steer pid|mpc]"
+            << " [--shape sigmoid|clamp|rational|poly]"
+            << " [--derivative-tau SECONDS]" << std::endl;
+  return -1;
+}
+
+int main(int argc, char *argv[])
+{
+  int steps = 20000;
+  int runs = 1;
+  unsigned seed = 0;
+  std::string record_path;
+  SteerShape shape = SteerShape::kSigmoid;
+  bool timed = false;
+  Controller base;
+  Simulator::Params params;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--steps") && i + 1 < argc) {
+      steps = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--dt") && i + 1 < argc) {
+      params.dt = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--noise") && i + 1 < argc) {
+      params.cte_noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--jitter") && i + 1 < argc) {
+      params.dt_jitter = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--target-speed") && i + 1 < argc) {
+      base.target_speed = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--corner-slowdown") && i + 1 < argc) {
+      base.corner_slowdown = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--schedule") && i + 1 < argc) {
+      auto schedule = std::make_shared<GainSchedule>();
+      std::string error;
+      if (!schedule->Load(argv[++i], &error)) {
+        std::cerr << argv[i] << ": " << error << std::endl;
+        return -1;
+      }
+      base.steer_schedule = schedule;
+    } else if (!strcmp(argv[i], "--derivative-tau") && i + 1 < argc) {
+      base.SetTiming(Controller::kFramePeriod, atof(argv[++i]));
+    } else if (!strcmp(argv[i], "--timed")) {
+      timed = true;
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (!strcmp(argv[i], "--shape") && i + 1 < argc &&
+               ParseSteerShape(argv[i + 1], &shape)) {
+      ++i;
+    } else if (!strcmp(argv[i], "--steer") && i + 1 < argc &&
+               ParseSteerMode(argv[i + 1], &base.steer_mode)) {
+      ++i;
+    } else {
+      return Usage(argv[0]);
+    }
+  }
+  if (runs < 1) return Usage(argv[0]);
+
+  Track track = Track::Default();
+
+  if (!record_path.empty()) {
+    TelemetryRecorder recorder;
+    if (!recorder.Open(record_path)) {
+      std::cerr << "Failed to open " << record_path << std::endl;
+      return -1;
+    }
+    Controller controller = base;
+    controller.steer_shape = shape;
+    Simulator sim(track, params, seed);
+    for (int i = 0; i < steps && !sim.OffTrack(); ++i) {
+      Telemetry t = sim.Observe();
+      Command cmd = controller.Update(t.cte, t.speed, t.steering_angle);
+      LogRecord record = { 0, 0, 0, t.cte, t.speed, t.steering_angle,
+                           cmd.steering_angle, cmd.throttle };
+      recorder.Append(record);
+      sim.Step(cmd);
+    }
+  }
+  EpisodeResult result = EpisodeResult();
+  long total_steps = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < runs; ++run) {
+    Controller controller = base;
+    controller.steer_shape = shape;
+    Simulator sim(track, params, seed);
+    result = RunEpisode(controller, sim, steps, timed);
+    total_steps += result.steps;
+  }
+  double wall = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  double simulated = total_steps * params.dt;
+
+  std::cout << "Steps: " << result.steps
+            << " Laps: " << result.distance / track.Length();
+  if (result.distance > 0) {
+    std::cout << " Lap time: "
+              << result.steps * params.dt * track.Length() / result.distance
+              << " s";
+  }
+  std::cout << " Off track: " << (result.off_track ? "yes" : "no") << std::endl;
+  std::cout << "CTE RMS: " << sqrt(result.Mse())
+            << " Max: " << result.max_cte << std::endl;
+  std::cout << "Simulated " << simulated << " s in " << wall << " s ("
+            << simulated / wall << "x real time, "
+            << total_steps / wall << " steps/s)" << std::endl;
+  return result.off_track ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "twiddle.h"
+
+/*
+* Tunes the steering gains with parallel Twiddle against the offline
+* simulator. With --tuner the given Tuner backend is used instead, or every
+* backend in turn with "all", each batch evaluated in parallel, and the
+* episodes each needed to reach --target-mse are reported.
+*
+* Usage: pid_tune [--threads N] [--restarts N] [--steps N] [--tol T]
+*                 [--seed S] [--noise METERS] [--target-speed MPH]
+*                 [--gains KP KI KD] [--tuner NAME|all] [--batch N]
+*                 [--max-episodes N] [--target-mse MSE]
+*/
+int main(int argc, char *argv[])
+{
+  TwiddleOptions options;
+  size_t threads = 0;
+  std::string tuner_name;
+  int batch = 0;
+  int max_episodes = 1000;
+  double target_mse = 0.02;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--restarts") && i + 1 < argc) {
+      options.restarts = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--steps") && i + 1 < argc) {
+      options.steps = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--tol") && i + 1 < argc) {
+      options.tol = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      options.seed = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--noise") && i + 1 < argc) {
+      options.sim.cte_noise = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--target-speed") && i + 1 < argc) {
+      options.target_speed = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--gains") && i + 3 < argc) {
+      for (int k = 0; k < 3; ++k) options.p[k] = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--tuner") && i + 1 < argc) {
+      tuner_name = argv[++i];
+    } else if (!strcmp(argv[i], "--batch") && i + 1 < argc) {
+      batch = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--max-episodes") && i + 1 < argc) {
+      max_episodes = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--target-mse") && i + 1 < argc) {
+      target_mse = atof(argv[++i]);
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--threads N] [--restarts N] [--steps N] [--tol T]"
+                << " [--seed S] [--noise METERS] [--target-speed MPH]"
+                << " [--gains KP KI KD]"
+                << " [--tuner twiddle|nelder-mead|cma-es|bayes|all]"
+                << " [--batch N] [--max-episodes N] [--target-mse MSE]"
+                << std::endl;
+      return -1;
+    }
+  }
+  if (options.restarts < 1) options.restarts = 1;
+
+  Track track = Track::Default();
+  ThreadPool pool(threads);
+
+  if (!tuner_name.empty()) {
+    std::vector<TunerKind> kinds;
+    TunerKind kind;
+    if (tuner_name == "all") {
+      kinds = { TunerKind::kTwiddle, TunerKind::kNelderMead,
+                TunerKind::kCmaEs, TunerKind::kBayesian };
+    } else if (ParseTunerKind(tuner_name.c_str(), &kind)) {
+      kinds.push_back(kind);
+    } else {
+      std::cerr << "Unknown tuner " << tuner_name << std::endl;
+      return -1;
+    }
+
+    TunerOptions tuner_options;
+    for (int k = 0; k < 3; ++k) {
+      tuner_options.p[k] = options.p[k];
+      tuner_options.dp[k] = options.dp[k];
+    }
+    tuner_options.tol = options.tol;
+    tuner_options.batch = batch > 0 ? batch : static_cast<int>(pool.size());
+    tuner_options.max_episodes = max_episodes;
+    tuner_options.seed = options.seed;
+
+    for (TunerKind k : kinds) {
+      std::unique_ptr<Tuner> tuner = MakeTuner(k, tuner_options);
+      auto start = std::chrono::steady_clock::now();
+      RunTuner(*tuner, track, options, pool);
+      double wall = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count();
+      const Tuner::Point &best = tuner->best();
+      std::cout << tuner->name()
+                << " Episodes: " << tuner->episodes()
+                << " To MSE " << target_mse << ": "
+                << tuner->EpisodesToReach(target_mse)
+                << " Error: " << tuner->best_error()
+                << " Kp: " << best.p[0]
+                << " Ki: " << best.p[1]
+                << " Kd: " << best.p[2]
+                << " Time: " << wall << " s" << std::endl;
+    }
+    return 0;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  TwiddleResult result = RunTwiddle(track, options, pool);
+  double wall = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "Threads: " << pool.size()
+            << " Episodes: " << result.episodes
+            << " Rounds: " << result.rounds
+            << " Time: " << wall << " s" << std::endl;
+  std::cout << "Delta: " << result.dp[0]
+            << " , " << result.dp[1]
+            << " , " << result.dp[2] << std::endl;
+  std::cout << "Solution: "
+            << " Kp: " << result.p[0]
+            << " Ki: " << result.p[1]
+            << " Kd: " << result.p[2]
+            << " Error: " << result.best_err
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,343 @@
+#include "reply_writer.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/*
+* FormatDouble uses the Grisu2 algorithm (Loitsch, "Printing Floating-Point
+* Numbers Quickly and Accurately with Integers", PLDI 2010). Its output
+* always reads back as the same double and is the shortest such string for
+* all but a tiny fraction of inputs, at a fraction of the cost of
+* printf("%.17g").
+*/
+
+namespace {
+
+// Do-it-yourself floating point number, value = f * 2^e.
+struct DiyFp {
+  uint64_t f;
+  int e;
+
+  DiyFp(uint64_t f, int e) : f(f), e(e) {}
+};
+
+DiyFp Sub(const DiyFp &x, const DiyFp &y) {
+  return DiyFp(x.f - y.f, x.e);
+}
+
+// Upper 64 bits of the 128 bit product, rounded.
+DiyFp Mul(const DiyFp &x, const DiyFp &y) {
+  const uint64_t u_lo = x.f & 0xFFFFFFFFu;
+  const uint64_t u_hi = x.f >> 32;
+  const uint64_t v_lo = y.f & 0xFFFFFFFFu;
+  const uint64_t v_hi = y.f >> 32;
+
+  const uint64_t p0 = u_lo * v_lo;
+  const uint64_t p1 = u_lo * v_hi;
+  const uint64_t p2 = u_hi * v_lo;
+  const uint64_t p3 = u_hi * v_hi;
+
+  uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+  q += uint64_t(1) << 31;
+  const uint64_t h = p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32);
+  return DiyFp(h, x.e + y.e + 64);
+}
+
+DiyFp Normalize(DiyFp x) {
+  while ((x.f >> 63) == 0) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+DiyFp NormalizeTo(const DiyFp &x, int target_exponent) {
+  return DiyFp(x.f << (x.e - target_exponent), target_exponent);
+}
+
+// Computes the normalized value v and its rounding boundaries m-, m+.
+void ComputeBoundaries(double value, DiyFp *v, DiyFp *m_minus, DiyFp *m_plus) {
+  const int kBias = 1023 + 52;
+  const int kMinExp = 1 - kBias;
+  const uint64_t kHiddenBit = uint64_t(1) << 52;
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint64_t E = bits >> 52;
+  const uint64_t F = bits & (kHiddenBit - 1);
+
+  DiyFp w = E == 0 ? DiyFp(F, kMinExp)
+                   : DiyFp(F + kHiddenBit, static_cast<int>(E) - kBias);
+  const bool lower_is_closer = F == 0 && E > 1;
+  DiyFp plus(2 * w.f + 1, w.e - 1);
+  DiyFp minus = lower_is_closer ? DiyFp(4 * w.f - 1, w.e - 2)
+                                : DiyFp(2 * w.f - 1, w.e - 1);
+
+  *m_plus = Normalize(plus);
+  *m_minus = NormalizeTo(minus, m_plus->e);
+  *v = Normalize(w);
+}
+
+// Target binary exponent of the scaled boundaries.
+const int kAlpha = -60;
+
+struct CachedPower {
+  uint64_t f;
+  int e;
+  int k;
+};
+
+// Normalized 10^k for k = -300, -292, ..., 324.
+const CachedPower kCachedPowers[] = {
+    { 0xAB70FE17C79AC6CA, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+    { 0xBE5691EF416BD60C, -1007, -284 },
+    { 0x8DD01FAD907FFC3C,  -980, -276 },
+    { 0xD3515C2831559A83,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5,  -927, -260 },
+    { 0xEA9C227723EE8BCB,  -901, -252 },
+    { 0xAECC49914078536D,  -874, -244 },
+    { 0x823C12795DB6CE57,  -847, -236 },
+    { 0xC21094364DFB5637,  -821, -228 },
+    { 0x9096EA6F3848984F,  -794, -220 },
+    { 0xD77485CB25823AC7,  -768, -212 },
+    { 0xA086CFCD97BF97F4,  -741, -204 },
+    { 0xEF340A98172AACE5,  -715, -196 },
+    { 0xB23867FB2A35B28E,  -688, -188 },
+    { 0x84C8D4DFD2C63F3B,  -661, -180 },
+    { 0xC5DD44271AD3CDBA,  -635, -172 },
+    { 0x936B9FCEBB25C996,  -608, -164 },
+    { 0xDBAC6C247D62A584,  -582, -156 },
+    { 0xA3AB66580D5FDAF6,  -555, -148 },
+    { 0xF3E2F893DEC3F126,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+    { 0x87625F056C7C4A8B,  -475, -124 },
+    { 0xC9BCFF6034C13053,  -449, -116 },
+    { 0x964E858C91BA2655,  -422, -108 },
+    { 0xDFF9772470297EBD,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+    { 0xF8A95FCF88747D94,  -343,  -84 },
+    { 0xB94470938FA89BCF,  -316,  -76 },
+    { 0x8A08F0F8BF0F156B,  -289,  -68 },
+    { 0xCDB02555653131B6,  -263,  -60 },
+    { 0x993FE2C6D07B7FAC,  -236,  -52 },
+    { 0xE45C10C42A2B3B06,  -210,  -44 },
+    { 0xAA242499697392D3,  -183,  -36 },
+    { 0xFD87B5F28300CA0E,  -157,  -28 },
+    { 0xBCE5086492111AEB,  -130,  -20 },
+    { 0x8CBCCC096F5088CC,  -103,  -12 },
+    { 0xD1B71758E219652C,   -77,   -4 },
+    { 0x9C40000000000000,   -50,    4 },
+    { 0xE8D4A51000000000,   -24,   12 },
+    { 0xAD78EBC5AC620000,     3,   20 },
+    { 0x813F3978F8940984,    30,   28 },
+    { 0xC097CE7BC90715B3,    56,   36 },
+    { 0x8F7E32CE7BEA5C70,    83,   44 },
+    { 0xD5D238A4ABE98068,   109,   52 },
+    { 0x9F4F2726179A2245,   136,   60 },
+    { 0xED63A231D4C4FB27,   162,   68 },
+    { 0xB0DE65388CC8ADA8,   189,   76 },
+    { 0x83C7088E1AAB65DB,   216,   84 },
+    { 0xC45D1DF942711D9A,   242,   92 },
+    { 0x924D692CA61BE758,   269,  100 },
+    { 0xDA01EE641A708DEA,   295,  108 },
+    { 0xA26DA3999AEF774A,   322,  116 },
+    { 0xF209787BB47D6B85,   348,  124 },
+    { 0xB454E4A179DD1877,   375,  132 },
+    { 0x865B86925B9BC5C2,   402,  140 },
+    { 0xC83553C5C8965D3D,   428,  148 },
+    { 0x952AB45CFA97A0B3,   455,  156 },
+    { 0xDE469FBD99A05FE3,   481,  164 },
+    { 0xA59BC234DB398C25,   508,  172 },
+    { 0xF6C69A72A3989F5C,   534,  180 },
+    { 0xB7DCBF5354E9BECE,   561,  188 },
+    { 0x88FCF317F22241E2,   588,  196 },
+    { 0xCC20CE9BD35C78A5,   614,  204 },
+    { 0x98165AF37B2153DF,   641,  212 },
+    { 0xE2A0B5DC971F303A,   667,  220 },
+    { 0xA8D9D1535CE3B396,   694,  228 },
+    { 0xFB9B7CD9A4A7443C,   720,  236 },
+    { 0xBB764C4CA7A44410,   747,  244 },
+    { 0x8BAB8EEFB6409C1A,   774,  252 },
+    { 0xD01FEF10A657842C,   800,  260 },
+    { 0x9B10A4E5E9913129,   827,  268 },
+    { 0xE7109BFBA19C0C9D,   853,  276 },
+    { 0xAC2820D9623BF429,   880,  284 },
+    { 0x80444B5E7AA7CF85,   907,  292 },
+    { 0xBF21E44003ACDD2D,   933,  300 },
+    { 0x8E679C2F5E44FF8F,   960,  308 },
+    { 0xD433179D9C8CB841,   986,  316 },
+    { 0x9E19DB92B4E31BA9,  1013,  324 },
+};
+const int kCachedPowersMinDecExp = -300;
+const int kCachedPowersDecStep = 8;
+
+// Returns c = 10^k such that e + c.e lands in [kAlpha, kAlpha + 28].
+CachedPower GetCachedPower(int e) {
+  const int f = kAlpha - e - 1;
+  const int k = (f * 78913) / (1 << 18) + static_cast<int>(f > 0);
+  const int index = (-kCachedPowersMinDecExp + k + (kCachedPowersDecStep - 1)) /
+                    kCachedPowersDecStep;
+  return kCachedPowers[index];
+}
+
+// Number of decimal digits of n, and the largest power of ten <= n.
+int FindLargestPow10(uint32_t n, uint32_t *pow10) {
+  static const uint32_t kPowers[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+  };
+  int k = 10;
+  while (k > 1 && n < kPowers[k - 1]) --k;
+  *pow10 = kPowers[k - 1];
+  return k;
+}
+
+void Round(char *buf, int len, uint64_t dist, uint64_t delta, uint64_t rest,
+           uint64_t ten_k) {
+  while (rest < dist && delta - rest >= ten_k &&
+         (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+    buf[len - 1]--;
+    rest += ten_k;
+  }
+}
+
+// Generates the digits of w, which lies inside (m_minus, m_plus).
+void DigitGen(char *buf, int *len, int *exponent, DiyFp m_minus, DiyFp w,
+              DiyFp m_plus) {
+  uint64_t delta = Sub(m_plus, m_minus).f;
+  uint64_t dist = Sub(m_plus, w).f;
+
+  const DiyFp one(uint64_t(1) << -m_plus.e, m_plus.e);
+  uint32_t p1 = static_cast<uint32_t>(m_plus.f >> -one.e);
+  uint64_t p2 = m_plus.f & (one.f - 1);
+
+  uint32_t pow10;
+  int n = FindLargestPow10(p1, &pow10);
+  while (n > 0) {
+    buf[(*len)++] = static_cast<char>('0' + p1 / pow10);
+    p1 %= pow10;
+    n--;
+    const uint64_t rest = (uint64_t(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      *exponent += n;
+      Round(buf, *len, dist, delta, rest, uint64_t(pow10) << -one.e);
+      return;
+    }
+    pow10 /= 10;
+  }
+
+  int m = 0;
+  for (;;) {
+    p2 *= 10;
+    buf[(*len)++] = static_cast<char>('0' + (p2 >> -one.e));
+    p2 &= one.f - 1;
+    m++;
+    delta *= 10;
+    dist *= 10;
+    if (p2 <= delta) break;
+  }
+  *exponent -= m;
+  Round(buf, *len, dist, delta, p2, one.f);
+}
+
+// Writes digits * 10^exponent in plain notation for values in [1e-4, 1e17)
+// and in scientific notation otherwise.
+size_t FormatDigits(char *out, const char *digits, int k, int exponent) {
+  const int n = k + exponent;
+  char *p = out;
+  if (k <= n && n <= 17) {
+    memcpy(p, digits, k);
+    p += k;
+    for (int i = k; i < n; ++i) *p++ = '0';
+    *p++ = '.';
+    *p++ = '0';
+  } else if (0 < n && n <= 17) {
+    memcpy(p, digits, n);
+    p += n;
+    *p++ = '.';
+    memcpy(p, digits + n, k - n);
+    p += k - n;
+  } else if (-4 < n && n <= 0) {
+    *p++ = '0';
+    *p++ = '.';
+    for (int i = n; i < 0; ++i) *p++ = '0';
+    memcpy(p, digits, k);
+    p += k;
+  } else {
+    *p++ = digits[0];
+    if (k > 1) {
+      *p++ = '.';
+      memcpy(p, digits + 1, k - 1);
+      p += k - 1;
+    }
+    *p++ = 'e';
+    int e = n - 1;
+    if (e < 0) {
+      *p++ = '-';
+      e = -e;
+    } else {
+      *p++ = '+';
+    }
+    if (e >= 100) {
+      *p++ = static_cast<char>('0' + e / 100);
+      e %= 100;
+    }
+    *p++ = static_cast<char>('0' + e / 10);
+    *p++ = static_cast<char>('0' + e % 10);
+  }
+  return p - out;
+}
+
+} // namespace
+
+size_t FormatDouble(double x, char *out) {
+  if (!std::isfinite(x)) {
+    memcpy(out, "null", 4);
+    return 4;
+  }
+  size_t sign = 0;
+  if (std::signbit(x)) {
+    *out++ = '-';
+    x = -x;
+    sign = 1;
+  }
+  if (x == 0) {
+    memcpy(out, "0.0", 3);
+    return sign + 3;
+  }
+
+  DiyFp v(0, 0), m_minus(0, 0), m_plus(0, 0);
+  ComputeBoundaries(x, &v, &m_minus, &m_plus);
+
+  const CachedPower cached = GetCachedPower(m_plus.e);
+  const DiyFp c_minus_k(cached.f, cached.e);
+  const DiyFp w = Mul(v, c_minus_k);
+  const DiyFp w_minus = Mul(m_minus, c_minus_k);
+  const DiyFp w_plus = Mul(m_plus, c_minus_k);
+
+  char digits[18];
+  int len = 0;
+  int exponent = -cached.k;
+  DigitGen(digits, &len, &exponent, DiyFp(w_minus.f + 1, w_minus.e), w,
+           DiyFp(w_plus.f - 1, w_plus.e));
+  return sign + FormatDigits(out, digits, len, exponent);
+}
+
+void ReplyWriter::Append(const char *s, size_t n) {
+  memcpy(buffer_ + length_, s, n);
+  length_ += n;
+}
+
+void ReplyWriter::WriteSteer(double steering_angle, double throttle) {
+  static const char kHead[] = "42[\"steer\",{\"steering_angle\":";
+  static const char kMid[] = ",\"throttle\":";
+  static const char kTail[] = "}]";
+
+  // Fixed text plus two numbers of kMaxDoubleLength always fits kCapacity.
+  length_ = 0;
+  Append(kHead, sizeof(kHead) - 1);
+  length_ += FormatDouble(steering_angle, buffer_ + length_);
+  Append(kMid, sizeof(kMid) - 1);
+  length_ += FormatDouble(throttle, buffer_ + length_);
+  Append(kTail, sizeof(kTail) - 1);
+}
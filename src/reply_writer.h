@@ -0,0 +1,40 @@
+#ifndef REPLY_WRITER_H
+#define REPLY_WRITER_H
+
+#include <cstddef>
+
+/*
+* Writes the shortest decimal representation of x that parses back to the
+* same double. out must hold at least kMaxDoubleLength bytes, the result is
+* not null terminated. Non-finite values are written as null like
+* nlohmann::json does. Returns the number of bytes written.
+*/
+const size_t kMaxDoubleLength = 32;
+size_t FormatDouble(double x, char *out);
+
+/*
+* Fixed-capacity buffer holding one outgoing SocketIO frame. It is meant to
+* be reused across control ticks so that building a reply never allocates.
+*/
+class ReplyWriter {
+public:
+  static const size_t kCapacity = 128;
+
+  ReplyWriter() : length_(0) {}
+
+  /*
+  * Formats '42["steer",{"steering_angle":S,"throttle":T}]' in place.
+  */
+  void WriteSteer(double steering_angle, double throttle);
+
+  const char *data() const { return buffer_; }
+  size_t length() const { return length_; }
+
+private:
+  void Append(const char *s, size_t n);
+
+  char buffer_[kCapacity];
+  size_t length_;
+};
+
+#endif /* REPLY_WRITER_H */
@@ -0,0 +1,166 @@
+#ifndef ROLLING_WINDOW_H
+#define ROLLING_WINDOW_H
+
+#include <cstddef>
+
+/*
+* Fixed-window smoothing filters over the last N samples. Storage lives
+* inside the object, so nothing is allocated after construction and every
+* Push is O(1) (O(N) for the median).
+*/
+
+/*
+* Mean of the last N samples, kept as a running sum. The sum uses Kahan
+* compensation and is recomputed exactly from the ring every time the ring
+* wraps, so rounding error cannot build up over long runs.
+*/
+template <size_t N>
+class RollingMean {
+  static_assert(N > 0, "window must hold at least one sample");
+
+public:
+  RollingMean() { Clear(); }
+
+  void Clear() {
+    count_ = 0;
+    head_ = 0;
+    sum_ = 0;
+    compensation_ = 0;
+  }
+
+  void Push(double x) {
+    if (count_ == N) {
+      Add(-ring_[head_]);
+    } else {
+      ++count_;
+    }
+    ring_[head_] = x;
+    Add(x);
+    if (++head_ == N) {
+      head_ = 0;
+      Resum();
+    }
+  }
+
+  /*
+  * Mean of the samples seen so far, 0 before the first one.
+  */
+  double Value() const { return count_ ? sum_ / count_ : 0; }
+
+  size_t size() const { return count_; }
+
+private:
+  void Add(double x) {
+    double y = x - compensation_;
+    double t = sum_ + y;
+    compensation_ = (t - sum_) - y;
+    sum_ = t;
+  }
+
+  void Resum() {
+    sum_ = 0;
+    compensation_ = 0;
+    for (size_t i = 0; i < count_; ++i) Add(ring_[i]);
+  }
+
+  double ring_[N];
+  size_t count_;
+  size_t head_;
+  double sum_;
+  double compensation_;
+};
+
+/*
+* Exponential moving average with the smoothing factor 2 / (N + 1) that
+* gives the same center of mass as an N sample mean. The first sample
+* initializes the average.
+*/
+template <size_t N>
+class RollingEma {
+  static_assert(N > 0, "window must hold at least one sample");
+
+public:
+  RollingEma() { Clear(); }
+
+  void Clear() {
+    value_ = 0;
+    count_ = 0;
+  }
+
+  void Push(double x) {
+    const double alpha = 2.0 / (N + 1);
+    value_ = count_ ? value_ + alpha * (x - value_) : x;
+    if (count_ < N) ++count_;
+  }
+
+  double Value() const { return value_; }
+
+  size_t size() const { return count_; }
+
+private:
+  double value_;
+  size_t count_;
+};
+
+/*
+* Median of the last N samples. A sorted copy of the window is kept next to
+* the ring, and each Push moves one element into place, O(N) for the small
+* windows this is meant for. With an even count the two middle samples are
+* averaged.
+*/
+template <size_t N>
+class RollingMedian {
+  static_assert(N > 0, "window must hold at least one sample");
+
+public:
+  RollingMedian() { Clear(); }
+
+  void Clear() {
+    count_ = 0;
+    head_ = 0;
+  }
+
+  void Push(double x) {
+    size_t pos;
+    if (count_ == N) {
+      // Reuse the slot of the sample that leaves the window.
+      pos = Find(ring_[head_]);
+    } else {
+      pos = count_++;
+    }
+    ring_[head_] = x;
+    if (++head_ == N) head_ = 0;
+
+    while (pos > 0 && sorted_[pos - 1] > x) {
+      sorted_[pos] = sorted_[pos - 1];
+      --pos;
+    }
+    while (pos + 1 < count_ && sorted_[pos + 1] < x) {
+      sorted_[pos] = sorted_[pos + 1];
+      ++pos;
+    }
+    sorted_[pos] = x;
+  }
+
+  double Value() const {
+    if (count_ == 0) return 0;
+    size_t mid = count_ / 2;
+    return count_ % 2 ? sorted_[mid] : (sorted_[mid - 1] + sorted_[mid]) / 2;
+  }
+
+  size_t size() const { return count_; }
+
+private:
+  size_t Find(double x) const {
+    size_t i = 0;
+    while (i + 1 < count_ && sorted_[i] != x) ++i;
+    return i;
+  }
+
+  double ring_[N];
+  double sorted_[N];
+  size_t count_;
+  size_t head_;
+};
+
+#endif /* ROLLING_WINDOW_H */
@@ -0,0 +1,264 @@
+#include "session.h"
+#include <math.h>
+#include <string>
+#include "json.hpp"
+#include "latency.h"
+#include "logger.h"
+#include "telemetry.h"
+
+// for convenience
+using json = nlohmann::json;
+
+namespace {
+
+const char kManual[] = "42[\"manual\",{}]";
+const char kReset[] = "42[\"reset\", {}]";
+
+// Checks if the SocketIO event has JSON data.
+// If there is data the JSON object in string format will be returned,
+// else the empty string "" will be returned.
+std::string hasData(std::string s) {
+  auto found_null = s.find("null");
+  auto b1 = s.find_first_of("[");
+  auto b2 = s.find_last_of("]");
+  if (found_null != std::string::npos) {
+    return "";
+  }
+  else if (b1 != std::string::npos && b2 != std::string::npos) {
+    return s.substr(b1, b2 - b1 + 1);
+  }
+  return "";
+}
+
+} // namespace
+
+Session::Session(ConfigStore *config, TelemetryRecorder *recorder,
+                 uint32_t id, Checkpoint *checkpoint)
+    : recorder_(recorder),
+      id_(id),
+      stats_(id),
+      last_frame_ns_(0),
+      config_(config),
+      config_version_(0),
+      checkpoint_(nullptr),
+      tuner_err_(0),
+      tuner_bound_(0),
+      tuner_num_(0) {
+  ControllerConfig defaults;
+  const ControllerConfig *c = &defaults;
+  if (config_) {
+    config_reader_.reset(new ConfigStore::Reader(config_));
+    c = config_reader_->Pin();
+  }
+  c->ApplyTo(&controller, false);
+  config_version_ = c->version;
+  use_twiddle_ = c->twiddle_enabled;
+  // Tuning pid_steer's gains is pointless when something else steers.
+  if (use_twiddle_ && c->steer_mode != SteerMode::kPID) {
+    LOG_ERROR("Session %u: not tuning, steer_mode is %s", id_,
+              SteerModeName(c->steer_mode));
+    use_twiddle_ = false;
+  } else if (use_twiddle_ && c->steer_schedule) {
+    LOG_ERROR("Session %u: not tuning, steer_schedule sets the gains", id_);
+    use_twiddle_ = false;
+  }
+  if (use_twiddle_) {
+    TunerOptions options;
+    const PID &pid = controller.pid_steer;
+    options.p[0] = pid.Kp;
+    options.p[1] = pid.Ki;
+    options.p[2] = pid.Kd;
+    for (int i = 0; i < 3; ++i) options.dp[i] = c->twiddle_dp[i];
+    options.tol = c->twiddle_tol;
+    options.seed = id;
+    tuner_ = MakeTuner(c->twiddle_tuner, options);
+    std::string state, error;
+    if (checkpoint && checkpoint->Claim(&state)) {
+      checkpoint_ = checkpoint;
+      if (state.empty()) {
+        LOG_INFO("Session %u: tuning from scratch", id_);
+      } else if (tuner_->Restore(state, &error)) {
+        LOG_INFO("Session %u: %s resumed after %d episodes", id_,
+                 tuner_->name(), tuner_->episodes());
+      } else {
+        LOG_ERROR("Session %u: cannot resume, tuning from scratch: %s", id_,
+                  error.c_str());
+        tuner_ = MakeTuner(c->twiddle_tuner, options);
+      }
+    }
+    tuner_steps_ = c->twiddle_steps;
+    tuner_crash_cte_ = c->twiddle_crash_cte;
+    stats_.twiddle_dp_sum = tuner_->step();
+  }
+  if (config_) config_reader_->Unpin();
+
+  Metrics::Get().Register(&stats_);
+}
+
+Session::~Session() {
+  Metrics::Get().Unregister(&stats_);
+  if (checkpoint_) checkpoint_->Release();
+}
+
+int Session::OnMessage(const char *data, size_t length, Outgoing *out) {
+  // "42" at the start of the message means there's a websocket message event.
+  // The 4 signifies a websocket message
+  // The 2 signifies a websocket event
+  LatencyStats &stats = LatencyStats::Get();
+  const uint64_t received = LatencyNow();
+  uint64_t start = received;
+  bool is_event = length > 2 && data[0] == '4' && data[1] == '2';
+  uint64_t now = LatencyNow();
+  stats[Stage::kFraming].Record(now - start);
+  if (!is_event) return 0;
+
+  Telemetry t;
+  start = now;
+  FrameType type = ParseTelemetry(data, length, &t);
+  now = LatencyNow();
+  stats[Stage::kParse].Record(now - start);
+  if (type == FrameType::kOther) {
+    // Events other than telemetry go through the generic JSON path.
+    start = now;
+    auto s = hasData(std::string(data, length));
+    if (s != "") {
+      // Nothing to do for other events yet, but a malformed one is counted
+      // rather than allowed to take the server down.
+      try {
+        json::parse(s);
+      } catch (const std::exception &) {
+        type = FrameType::kInvalid;
+      }
+    } else {
+      type = FrameType::kNoData;
+    }
+    now = LatencyNow();
+    stats[Stage::kJsonFallback].Record(now - start);
+  }
+
+  Metrics &metrics = Metrics::Get();
+  int n = 0;
+  if (type == FrameType::kTelemetry) {
+    start = now;
+    if (config_ && config_->version() != config_version_) ApplyConfig();
+    if (use_twiddle_ && tuner_num_ == 0) TunerBegin();
+
+    double dt = last_frame_ns_ ? (received - last_frame_ns_) * 1e-9 : 0;
+    last_frame_ns_ = received;
+    Command cmd = controller.Update(t.cte, t.speed, t.steering_angle, dt);
+
+    bool reset = use_twiddle_ && TunerEnd(t.cte);
+    if (reset) {
+      out[n].data = kReset;
+      out[n].length = sizeof(kReset) - 1;
+      ++n;
+    }
+
+    if (recorder_) {
+      uint32_t flags = kLogTimed | (reset ? kLogReset : 0);
+      LogRecord record = { received, id_, flags,
+                           t.cte, t.speed, t.steering_angle,
+                           cmd.steering_angle, cmd.throttle };
+      recorder_->Append(record);
+    }
+
+    now = LatencyNow();
+    stats[Stage::kControl].Record(now - start);
+
+    metrics.Increment(Counter::kFrames);
+    if (fabs(cmd.steering_angle) >= kSteerSaturation) {
+      metrics.Increment(Counter::kSteerSaturated);
+    }
+    if (fabs(cmd.throttle) >= 1) {
+      metrics.Increment(Counter::kThrottleSaturated);
+    }
+    stats_.frames.store(stats_.frames.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+    stats_.cte_sq_sum.store(
+        stats_.cte_sq_sum.load(std::memory_order_relaxed) + t.cte * t.cte,
+        std::memory_order_relaxed);
+
+    start = now;
+    reply_.WriteSteer(cmd.steering_angle, cmd.throttle);
+    stats[Stage::kSerialize].Record(LatencyNow() - start);
+    LOG_DEBUG("%.*s", static_cast<int>(reply_.length()), reply_.data());
+    out[n].data = reply_.data();
+    out[n].length = reply_.length();
+    ++n;
+  } else if (type == FrameType::kInvalid) {
+    metrics.Increment(Counter::kParseFailures);
+  } else if (type == FrameType::kNoData) {
+    // Manual driving
+    out[n].data = kManual;
+    out[n].length = sizeof(kManual) - 1;
+    ++n;
+  }
+  return n;
+}
+
+void Session::ApplyConfig() {
+
+  // The tuner owns the steering gains, so steering changes wait until it is
+  // gone, and its own settings only take effect for new sessions.
+  const ControllerConfig *c = config_reader_->Pin();
+  c->ApplyTo(&controller, tuner_ != nullptr);
+  config_version_ = c->version;
+  config_reader_->Unpin();
+  LOG_INFO("Session %u: config version %llu applied", id_,
+           static_cast<unsigned long long>(config_version_));
+}
+
+void Session::TunerBegin() {
+
+  PID &pid_steer = controller.pid_steer;
+  if (tuner_->told() == tuner_->pending().size()) {
+    tuner_->Ask(&tuner_batch_);
+    if (tuner_batch_.empty()) {
+      const double *p = tuner_->best().p;
+      pid_steer.Init(p[0], p[1], p[2]);
+      use_twiddle_ = false;
+      LOG_INFO("Session %u: %s done after %d episodes, error %g", id_,
+               tuner_->name(), tuner_->episodes(), tuner_->best_error());
+      LOG_INFO("Solution:  Kp: %g Ki: %g Kd: %g",
+               pid_steer.Kp, pid_steer.Ki, pid_steer.Kd);
+      return;
+    }
+  }
+  const double *p = tuner_->pending()[tuner_->told()].p;
+  pid_steer.Init(p[0], p[1], p[2]);
+  tuner_bound_ = tuner_->bound() * tuner_steps_;
+  LOG_INFO("Session %u: %s episode %d  Kp: %g Ki: %g Kd: %g", id_,
+           tuner_->name(), tuner_->episodes(),
+           pid_steer.Kp, pid_steer.Ki, pid_steer.Kd);
+}
+
+bool Session::TunerEnd(double cte) {
+
+  if (!use_twiddle_) return false;
+  tuner_err_ += cte * cte;
+  ++tuner_num_;
+  if ((tuner_num_ % 100) == 0) LOG_INFO("%g", tuner_err_ / tuner_num_);
+  const bool crashed = fabs(cte) > tuner_crash_cte_;
+  if (crashed) {
+    tuner_err_ += (tuner_steps_ - tuner_num_) * tuner_crash_cte_ *
+                  tuner_crash_cte_;
+  }
+  if (!crashed && tuner_err_ <= tuner_bound_ && tuner_num_ < tuner_steps_) {
+    return false;
+  }
+  if (tuner_num_ < tuner_steps_) {
+    LOG_INFO("Session %u: episode stopped after %d frames, %s", id_,
+             tuner_num_, crashed ? "crashed" : "cannot improve");
+    stats_.twiddle_stopped.store(stats_.twiddle_stopped.load() + 1);
+  }
+
+  tuner_->Tell(std::vector<double>(1, tuner_err_ / tuner_steps_));
+  tuner_err_ = 0;
+  tuner_num_ = 0;
+  if (checkpoint_) checkpoint_->Save(tuner_->Save());
+
+  stats_.twiddle_episodes.store(stats_.twiddle_episodes.load() + 1);
+  stats_.twiddle_best.store(tuner_->best_error());
+  stats_.twiddle_dp_sum.store(tuner_->step());
+  return true;
+}
@@ -0,0 +1,103 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "checkpoint.h"
+#include "config.h"
+#include "controller.h"
+#include "metrics.h"
+#include "reply_writer.h"
+#include "telemetry_log.h"
+
+/*
+* Frame to send back to the simulator. The bytes stay valid until the next
+* call to Session::OnMessage.
+*/
+struct Outgoing {
+  const char *data;
+  size_t length;
+};
+
+/*
+* Controller state of one simulator connection: the PID controllers, the
+* online gain search and the reply buffer. The server keeps one Session
+* per WebSocket so simulators connected at the same time do not share state.
+*/
+class Session {
+public:
+  static const int kMaxReplies = 2;
+
+  Controller controller;
+
+  /*
+  * The controller and the tuner settings start from the current
+  * configuration of the store, and later versions are applied between
+  * ticks; without a store the Controller defaults are used. When a recorder
+  * is given every tick is logged to it under the given session id. A
+  * tuning session that gets hold of the checkpoint resumes from it and
+  * saves its tuner there after every episode.
+  */
+  explicit Session(ConfigStore *config = nullptr,
+                   TelemetryRecorder *recorder = nullptr, uint32_t id = 0,
+                   Checkpoint *checkpoint = nullptr);
+
+  /*
+  * Destructor, removes the session from /metrics and lets go of the
+  * checkpoint.
+  */
+  ~Session();
+
+  Session(const Session &) = delete;
+  Session &operator=(const Session &) = delete;
+
+  /*
+  * Handle one raw SocketIO frame and write up to kMaxReplies frames to send
+  * back, in order. Returns the number of frames written. The controller is
+  * driven with the time between telemetry frames, taken on a monotonic
+  * clock as soon as the frame arrives.
+  */
+  int OnMessage(const char *data, size_t length, Outgoing *out);
+
+private:
+  /*
+  * Pick up a newer configuration from the store, keeping the PID state.
+  */
+  void ApplyConfig();
+
+  /*
+  * The tuner, run online against the simulator one episode per candidate.
+  * Every episode ends with a reset so all candidates start from the same
+  * place; once the tuner is done its best gains are kept. An episode ends
+  * early when the car crashes, charged the crash cte squared for every
+  * frame left, or as soon as its error is above the tuner's bound.
+  */
+  void TunerBegin();
+  bool TunerEnd(double cte);
+
+  ReplyWriter reply_;
+  TelemetryRecorder *recorder_;
+  uint32_t id_;
+  SessionStats stats_;
+  uint64_t last_frame_ns_;  // receipt time of the previous telemetry frame
+
+  // Configuration, checked once per tick without locking.
+  ConfigStore *config_;
+  std::unique_ptr<ConfigStore::Reader> config_reader_;
+  uint64_t config_version_;
+
+  // Steering gains belong to tuner_ from the start of tuning on.
+  bool use_twiddle_;
+  std::unique_ptr<Tuner> tuner_;
+  std::vector<Tuner::Point> tuner_batch_;
+  Checkpoint *checkpoint_;   // owned by this session, or null
+  double tuner_err_;
+  double tuner_bound_;   // on tuner_err_
+  double tuner_crash_cte_;
+  int tuner_steps_;
+  int tuner_num_;
+};
+
+#endif /* SESSION_H */
@@ -0,0 +1,95 @@
+#include "simulator.h"
+#include <math.h>
+
+namespace {
+
+double Clamp(double x, double lo, double hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+
+} // namespace
+
+constexpr double Simulator::kMphPerMps;
+
+Simulator::Simulator(const Track &track, const Params &params, unsigned seed)
+    : track_(track), params_(params), seed_(seed) {
+  Reset();
+}
+
+void Simulator::Reset() {
+
+  hint_ = 0;
+  rng_.seed(seed_);
+  x = track_.xs[0];
+  y = track_.ys[0];
+  cte = track_.Cte(x, y, &hint_, &psi);
+  v = 0;
+  delta = 0;
+  distance = 0;
+  frame_dt = 0;
+  Measure();
+}
+
+void Simulator::Measure() {
+
+  measured_cte_ = cte;
+  if (params_.cte_noise > 0) {
+    std::normal_distribution<double> noise(0, params_.cte_noise);
+    measured_cte_ += noise(rng_);
+  }
+}
+
+Telemetry Simulator::Observe() const {
+
+  Telemetry t;
+  t.cte = measured_cte_;
+  t.speed = v * kMphPerMps;
+  t.steering_angle = delta * params_.max_steer;
+  return t;
+}
+
+void Simulator::Step(const Command &cmd) {
+
+  double dt = params_.dt;
+  if (params_.dt_jitter > 0) {
+    std::normal_distribution<double> jitter(0, params_.dt_jitter);
+    dt *= fmax(0.2, 1 + jitter(rng_));
+  }
+  frame_dt = dt;
+  delta = Clamp(cmd.steering_angle, -1, 1);
+  double throttle = Clamp(cmd.throttle, -1, 1);
+
+  // A positive steering angle turns right, i.e. clockwise.
+  double wheel = delta * params_.max_steer * M_PI / 180;
+  x += v * cos(psi) * dt;
+  y += v * sin(psi) * dt;
+  psi -= v / params_.wheelbase * tan(wheel) * dt;
+  distance += v * dt;
+  v += (throttle * params_.max_accel - params_.drag * v) * dt;
+  if (v < 0) v = 0;
+
+  cte = track_.Cte(x, y, &hint_, nullptr);
+  Measure();
+}
+
+EpisodeResult RunEpisode(Controller &controller, Simulator &sim, int steps,
+                         bool timed, double max_cte_sq_sum) {
+
+  EpisodeResult r = { 0, 0, 0, 0, false };
+  for (int i = 0; i < steps; ++i) {
+    Telemetry t = sim.Observe();
+    sim.Step(timed ? controller.Update(t.cte, t.speed, t.steering_angle,
+                                       sim.frame_dt)
+                   : controller.Update(t.cte, t.speed, t.steering_angle));
+    r.steps += 1;
+    r.cte_sq_sum += sim.cte * sim.cte;
+    if (fabs(sim.cte) > r.max_cte) r.max_cte = fabs(sim.cte);
+    if (sim.OffTrack()) {
+      r.off_track = true;
+      break;
+    }
+    if (r.cte_sq_sum > max_cte_sq_sum) break;
+  }
+  r.distance = sim.distance;
+  return r;
+}
@@ -0,0 +1,111 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <limits>
+#include <random>
+#include "controller.h"
+#include "telemetry.h"
+#include "track.h"
+
+/*
+* Headless stand-in for the Unity simulator: a kinematic bicycle model
+* driving on a Track, stepped with a fixed time step.
+*/
+class Simulator {
+public:
+  static constexpr double kMphPerMps = 2.23694;
+
+  /*
+  * Vehicle and integration parameters.
+  */
+  struct Params {
+    double dt;          // seconds per telemetry frame
+    double wheelbase;   // meters
+    double max_steer;   // wheel angle at steering_angle = 1, degrees
+    double max_accel;   // m/s^2 at full throttle
+    double drag;        // 1/s, linear speed loss
+    double cte_noise;   // standard deviation of the reported cte, meters
+    double dt_jitter;   // standard deviation of the frame period, fraction of dt
+    Params() : dt(0.05), wheelbase(2.67), max_steer(25), max_accel(5),
+               drag(0.1), cte_noise(0), dt_jitter(0) {}
+  };
+
+  /*
+  * Car state in track coordinates.
+  */
+  double x;
+  double y;
+  double psi;     // heading, radians counter-clockwise
+  double v;       // m/s
+  double delta;   // current steering command in [-1, 1]
+  double cte;     // signed distance to the centerline
+  double distance;
+  double frame_dt;  // seconds covered by the last Step, 0 before the first
+
+  /*
+  * The seed drives the measurement noise, so equal seeds give identical
+  * runs.
+  */
+  Simulator(const Track &track, const Params &params = Params(),
+            unsigned seed = 0);
+
+  /*
+  * Put the car back on the start line at rest and restart the noise
+  * sequence.
+  */
+  void Reset();
+
+  /*
+  * Telemetry as the Unity simulator would report it: cte in meters, speed
+  * in mph and the current steering angle in degrees.
+  */
+  Telemetry Observe() const;
+
+  /*
+  * Apply a command and advance the model by one time step. With dt_jitter
+  * the step length varies from frame to frame, as when frames are delayed.
+  */
+  void Step(const Command &cmd);
+
+  /*
+  * True once the car has left the road.
+  */
+  bool OffTrack() const { return cte > track_.half_width || cte < -track_.half_width; }
+
+  const Params &params() const { return params_; }
+
+private:
+  const Track &track_;
+  Params params_;
+  size_t hint_;
+  unsigned seed_;
+  std::mt19937 rng_;
+  double measured_cte_;
+
+  void Measure();
+};
+
+/*
+* Summary of one closed-loop run.
+*/
+struct EpisodeResult {
+  int steps;
+  double cte_sq_sum;
+  double max_cte;
+  double distance;
+  bool off_track;
+
+  double Mse() const { return steps ? cte_sq_sum / steps : 0; }
+};
+
+/*
+* Drive the simulator with the controller for the given number of frames,
+* stopping early if the car leaves the road or the summed squared cte goes
+* above max_cte_sq_sum. When timed, the controller is given the measured
+* frame period.
+*/
+EpisodeResult RunEpisode(
+    Controller &controller, Simulator &sim, int steps, bool timed = false,
+    double max_cte_sq_sum = std::numeric_limits<double>::infinity());
+
+#endif /* SIMULATOR_H */
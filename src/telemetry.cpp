@@ -0,0 +1,173 @@
+#include "telemetry.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Longest numeric token we accept, the simulator sends around 10 chars.
+const size_t kMaxNumberLength = 63;
+
+struct Cursor {
+  const char *p;
+  const char *end;
+};
+
+bool IsSpace(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+void SkipSpace(Cursor &c) {
+  while (c.p < c.end && IsSpace(*c.p)) ++c.p;
+}
+
+bool Consume(Cursor &c, char ch) {
+  SkipSpace(c);
+  if (c.p < c.end && *c.p == ch) {
+    ++c.p;
+    return true;
+  }
+  return false;
+}
+
+bool ConsumeLiteral(Cursor &c, const char *lit, size_t n) {
+  SkipSpace(c);
+  if (static_cast<size_t>(c.end - c.p) >= n && memcmp(c.p, lit, n) == 0) {
+    c.p += n;
+    return true;
+  }
+  return false;
+}
+
+// Reads a JSON string starting at the opening quote. On success the raw
+// (still escaped) contents are returned through [begin, end).
+bool ReadString(Cursor &c, const char **begin, const char **end) {
+  SkipSpace(c);
+  if (c.p >= c.end || *c.p != '"') return false;
+  ++c.p;
+  *begin = c.p;
+  while (c.p < c.end) {
+    if (*c.p == '\\') {
+      c.p += 2;
+    } else if (*c.p == '"') {
+      *end = c.p;
+      ++c.p;
+      return true;
+    } else {
+      ++c.p;
+    }
+  }
+  return false;
+}
+
+// Skips any JSON value, tracking nesting depth for objects and arrays.
+bool SkipValue(Cursor &c) {
+  SkipSpace(c);
+  int depth = 0;
+  while (c.p < c.end) {
+    char ch = *c.p;
+    if (ch == '"') {
+      const char *b, *e;
+      if (!ReadString(c, &b, &e)) return false;
+    } else if (ch == '{' || ch == '[') {
+      ++depth;
+      ++c.p;
+    } else if (ch == '}' || ch == ']') {
+      if (depth == 0) return true;
+      --depth;
+      ++c.p;
+    } else if (ch == ',' && depth == 0) {
+      return true;
+    } else {
+      ++c.p;
+    }
+    if (depth == 0 && (c.p >= c.end || *c.p == ',' || *c.p == '}' ||
+                       *c.p == ']')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Converts [begin, end) to a double through a stack copy, so the result is
+// identical to std::stod on the same text.
+bool ToDouble(const char *begin, const char *end, double *out) {
+  size_t n = end - begin;
+  if (n == 0 || n > kMaxNumberLength) return false;
+  char buf[kMaxNumberLength + 1];
+  memcpy(buf, begin, n);
+  buf[n] = '\0';
+  char *stop;
+  *out = strtod(buf, &stop);
+  return stop == buf + n;
+}
+
+// Reads a numeric field that is either a quoted string or a bare number.
+// Returns 1 on success, 0 for null and -1 on error.
+int ReadNumber(Cursor &c, double *out) {
+  SkipSpace(c);
+  if (ConsumeLiteral(c, "null", 4)) return 0;
+  const char *b, *e;
+  if (c.p < c.end && *c.p == '"') {
+    if (!ReadString(c, &b, &e)) return -1;
+  } else {
+    b = c.p;
+    while (c.p < c.end && *c.p != ',' && *c.p != '}' && !IsSpace(*c.p)) {
+      ++c.p;
+    }
+    e = c.p;
+  }
+  return ToDouble(b, e, out) ? 1 : -1;
+}
+
+bool KeyIs(const char *b, const char *e, const char *key, size_t n) {
+  return static_cast<size_t>(e - b) == n && memcmp(b, key, n) == 0;
+}
+
+} // namespace
+
+FrameType ParseTelemetry(const char *data, size_t length, Telemetry *out) {
+  Cursor c = { data, data + length };
+  if (length < 2 || data[0] != '4' || data[1] != '2') return FrameType::kInvalid;
+  c.p += 2;
+
+  const char *b, *e;
+  if (!Consume(c, '[') || !ReadString(c, &b, &e)) return FrameType::kOther;
+  if (!KeyIs(b, e, "telemetry", 9)) return FrameType::kOther;
+  if (!Consume(c, ',')) return FrameType::kNoData;
+  if (ConsumeLiteral(c, "null", 4)) return FrameType::kNoData;
+  if (!Consume(c, '{')) return FrameType::kInvalid;
+
+  const int kCte = 1, kSpeed = 2, kAngle = 4;
+  int found = 0;
+  if (!Consume(c, '}')) {
+    do {
+      if (!ReadString(c, &b, &e) || !Consume(c, ':')) return FrameType::kInvalid;
+      double *field = nullptr;
+      int bit = 0;
+      if (KeyIs(b, e, "cte", 3)) {
+        field = &out->cte;
+        bit = kCte;
+      } else if (KeyIs(b, e, "speed", 5)) {
+        field = &out->speed;
+        bit = kSpeed;
+      } else if (KeyIs(b, e, "steering_angle", 14)) {
+        field = &out->steering_angle;
+        bit = kAngle;
+      }
+      if (field) {
+        int r = ReadNumber(c, field);
+        if (r == 0) return FrameType::kNoData;
+        if (r < 0) return FrameType::kInvalid;
+        found |= bit;
+      } else if (!SkipValue(c)) {
+        return FrameType::kInvalid;
+      }
+    } while (Consume(c, ','));
+    if (!Consume(c, '}')) return FrameType::kInvalid;
+  }
+  if (!Consume(c, ']')) return FrameType::kInvalid;
+
+  if (found == 0) return FrameType::kNoData;
+  return found == (kCte | kSpeed | kAngle) ? FrameType::kTelemetry
+                                           : FrameType::kInvalid;
+}
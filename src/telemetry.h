@@ -0,0 +1,32 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstddef>
+
+/*
+* Values carried by a "telemetry" SocketIO event.
+*/
+struct Telemetry {
+  double cte;
+  double speed;
+  double steering_angle;
+};
+
+/*
+* Classification of an incoming SocketIO frame.
+*/
+enum class FrameType {
+  kTelemetry, // telemetry event, all fields extracted
+  kNoData,    // telemetry event without data, i.e. manual driving
+  kOther,     // any other event, left to the generic JSON path
+  kInvalid    // not a "42[...]" event or malformed telemetry
+};
+
+/*
+* Parses a raw '42["telemetry",{...}]' frame in a single pass over the
+* buffer without allocating. The buffer does not need to be null
+* terminated. Field values may be JSON strings or plain numbers.
+*/
+FrameType ParseTelemetry(const char *data, size_t length, Telemetry *out);
+
+#endif /* TELEMETRY_H */
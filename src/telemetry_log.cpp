@@ -0,0 +1,130 @@
+#include "telemetry_log.h"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kMagic[8] = "PIDLOG1";
+
+// Records buffered before the writer thread is woken up.
+const size_t kFlushRecords = 4096;
+
+uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+TelemetryRecorder::TelemetryRecorder()
+    : file_(nullptr), start_ns_(0), stop_(false) {}
+
+TelemetryRecorder::~TelemetryRecorder() {
+  Close();
+}
+
+bool TelemetryRecorder::Open(const std::string &path) {
+  Close();
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_) return false;
+
+  LogHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kLogVersion;
+  header.record_size = sizeof(LogRecord);
+  if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+    std::fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+
+  start_ns_ = NowNs();
+  active_.reserve(kFlushRecords);
+  writing_.reserve(kFlushRecords);
+  stop_ = false;
+  writer_ = std::thread(&TelemetryRecorder::WriterLoop, this);
+  return true;
+}
+
+void TelemetryRecorder::Close() {
+  if (!file_) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+  std::fclose(file_);
+  file_ = nullptr;
+}
+
+void TelemetryRecorder::Append(LogRecord record) {
+  record.time_ns = (record.flags & kLogTimed ? record.time_ns : NowNs()) -
+                   start_ns_;
+  bool full;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) return;
+    active_.push_back(record);
+    full = active_.size() >= kFlushRecords;
+  }
+  if (full) wake_.notify_one();
+}
+
+void TelemetryRecorder::WriterLoop() {
+  for (;;) {
+    bool stop;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // Wake up on a full buffer, on shutdown, or once a second so that a
+      // slow session still reaches the disk.
+      wake_.wait_for(lock, std::chrono::seconds(1), [this] {
+        return stop_ || active_.size() >= kFlushRecords;
+      });
+      active_.swap(writing_);
+      stop = stop_;
+    }
+    if (!writing_.empty()) {
+      std::fwrite(writing_.data(), sizeof(LogRecord), writing_.size(), file_);
+      std::fflush(file_);
+      writing_.clear();
+    }
+    if (stop) return;
+  }
+}
+
+TelemetryLog::TelemetryLog()
+    : map_(MAP_FAILED), map_size_(0), records_(nullptr), count_(0) {}
+
+TelemetryLog::~TelemetryLog() {
+  if (map_ != MAP_FAILED) munmap(map_, map_size_);
+}
+
+bool TelemetryLog::Open(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(LogHeader))) {
+    close(fd);
+    return false;
+  }
+  map_size_ = st.st_size;
+  map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map_ == MAP_FAILED) return false;
+
+  const LogHeader *header = static_cast<const LogHeader *>(map_);
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kLogVersion ||
+      header->record_size != sizeof(LogRecord)) {
+    return false;
+  }
+  records_ = reinterpret_cast<const LogRecord *>(header + 1);
+  count_ = (map_size_ - sizeof(LogHeader)) / sizeof(LogRecord);
+  return true;
+}
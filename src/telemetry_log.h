@@ -0,0 +1,104 @@
+#ifndef TELEMETRY_LOG_H
+#define TELEMETRY_LOG_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+* Binary telemetry log: a LogHeader followed by fixed-size LogRecords, one
+* per control tick, in native byte order.
+*/
+struct LogHeader {
+  char magic[8];          // "PIDLOG1\0"
+  uint32_t version;
+  uint32_t record_size;   // sizeof(LogRecord)
+  uint64_t reserved;
+};
+
+struct LogRecord {
+  uint64_t time_ns;       // since the recorder was opened
+  uint32_t session;       // connection the frame belongs to
+  uint32_t flags;         // kLogReset, kLogTimed
+  double cte;             // received telemetry
+  double speed;
+  double steering_angle;
+  double steer_command;   // emitted command
+  double throttle_command;
+};
+
+const uint32_t kLogVersion = 1;
+const uint32_t kLogReset = 1;   // a "reset" was sent this tick
+const uint32_t kLogTimed = 2;   // time_ns is the frame receipt time and the
+                                // controller used the time since the
+                                // session's previous frame
+
+/*
+* Appends records to a log file. Append copies the record into an in-memory
+* buffer, and a background thread writes full buffers to disk, so the
+* control loop never waits on file I/O.
+*/
+class TelemetryRecorder {
+public:
+  TelemetryRecorder();
+  ~TelemetryRecorder();
+
+  /*
+  * Create or truncate the file and write the header.
+  */
+  bool Open(const std::string &path);
+
+  /*
+  * Flush everything still buffered and close the file.
+  */
+  void Close();
+
+  /*
+  * Queue one record, stamping time_ns. With kLogTimed, time_ns is taken as
+  * a steady clock reading (LatencyNow) and made relative to the open time
+  * instead. Safe to call from several threads.
+  */
+  void Append(LogRecord record);
+
+private:
+  void WriterLoop();
+
+  std::FILE *file_;
+  uint64_t start_ns_;
+  std::vector<LogRecord> active_;
+  std::vector<LogRecord> writing_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread writer_;
+  bool stop_;
+};
+
+/*
+* Read-only view of a log file mapped into memory.
+*/
+class TelemetryLog {
+public:
+  TelemetryLog();
+  ~TelemetryLog();
+
+  /*
+  * Map the file and validate its header. Returns false on any error.
+  */
+  bool Open(const std::string &path);
+
+  const LogRecord *records() const { return records_; }
+  size_t size() const { return count_; }
+
+private:
+  void *map_;
+  size_t map_size_;
+  const LogRecord *records_;
+  size_t count_;
+};
+
+#endif /* TELEMETRY_LOG_H */
@@ -0,0 +1,75 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threads)
+    : job_(nullptr), count_(0), next_(0), finished_(0), active_(0),
+      generation_(0), stop_(false) {
+  if (threads == 0) threads = std::thread::hardware_concurrency();
+  // The calling thread takes part in Run, so start one worker less.
+  for (size_t i = 1; i < threads; ++i) {
+    workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto &w : workers_) w.join();
+}
+
+void ThreadPool::Run(size_t n, const std::function<void(size_t)> &job) {
+  if (n == 0) return;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Late workers from the previous batch must be out before it is reused.
+    done_.wait(lock, [this] { return active_ == 0; });
+    job_ = &job;
+    count_ = n;
+    next_ = 0;
+    finished_ = 0;
+    ++generation_;
+  }
+  wake_.notify_all();
+  Drain(&job, n);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return finished_ == count_ && active_ == 0; });
+  job_ = nullptr;
+}
+
+void ThreadPool::Drain(const std::function<void(size_t)> *job, size_t count) {
+  size_t done = 0;
+  for (;;) {
+    size_t i = next_.fetch_add(1);
+    if (i >= count) break;
+    (*job)(i);
+    ++done;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  finished_ += done;
+  if (finished_ == count_) done_.notify_all();
+}
+
+void ThreadPool::WorkerLoop() {
+  unsigned long seen = 0;
+  for (;;) {
+    const std::function<void(size_t)> *job;
+    size_t count;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+      if (stop_) return;
+      seen = generation_;
+      job = job_;
+      count = count_;
+      if (!job) continue;
+      ++active_;
+    }
+    Drain(job, count);
+    std::lock_guard<std::mutex> lock(mutex_);
+    --active_;
+    done_.notify_all();
+  }
+}
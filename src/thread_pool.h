@@ -0,0 +1,52 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Fixed set of worker threads that run indexed batches of jobs. Workers are
+* started once and reused, so per-batch overhead is a wakeup rather than a
+* thread creation.
+*/
+class ThreadPool {
+public:
+  /*
+  * Start the given number of workers, or one per core when zero.
+  */
+  explicit ThreadPool(size_t threads = 0);
+
+  ~ThreadPool();
+
+  /*
+  * Call job(i) for i in [0, n) across the workers and the calling thread,
+  * returning once every call has finished.
+  */
+  void Run(size_t n, const std::function<void(size_t)> &job);
+
+  size_t size() const { return workers_.size() + 1; }
+
+private:
+  void WorkerLoop();
+  void Drain(const std::function<void(size_t)> *job, size_t count);
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+
+  const std::function<void(size_t)> *job_;
+  size_t count_;
+  std::atomic<size_t> next_;
+  size_t finished_;
+  size_t active_;
+  unsigned long generation_;
+  bool stop_;
+};
+
+#endif /* THREAD_POOL_H */
@@ -0,0 +1,79 @@
+#include "track.h"
+#include <math.h>
+
+namespace {
+
+// Distance squared from (x, y) to segment i.
+double SegmentDist2(const Track &t, size_t i, double x, double y) {
+  size_t j = i + 1 == t.xs.size() ? 0 : i + 1;
+  double sx = t.xs[j] - t.xs[i];
+  double sy = t.ys[j] - t.ys[i];
+  double u = ((x - t.xs[i]) * sx + (y - t.ys[i]) * sy) / (sx * sx + sy * sy);
+  if (u < 0) u = 0;
+  if (u > 1) u = 1;
+  double dx = x - (t.xs[i] + u * sx);
+  double dy = y - (t.ys[i] + u * sy);
+  return dx * dx + dy * dy;
+}
+
+} // namespace
+
+Track Track::Default() {
+
+  // r(theta) = R + a sin(2 theta) + b cos(3 theta) is closed by construction
+  // and its radius of curvature stays above 60 m with these constants.
+  const double R = 200;
+  const double a = 50;
+  const double b = 25;
+  const int n = 1400;
+
+  Track t;
+  t.half_width = 4;
+  for (int i = 0; i < n; ++i) {
+    double theta = 2 * M_PI * i / n;
+    double r = R + a * sin(2 * theta) + b * cos(3 * theta);
+    t.xs.push_back(r * cos(theta));
+    t.ys.push_back(r * sin(theta));
+  }
+  return t;
+}
+
+double Track::Cte(double x, double y, size_t *hint, double *heading) const {
+
+  const size_t n = xs.size();
+  size_t best = *hint % n;
+  double best_d = SegmentDist2(*this, best, x, y);
+
+  // Walk along the centerline while the distance keeps shrinking.
+  for (int dir = 1; dir >= -1; dir -= 2) {
+    for (;;) {
+      size_t next = dir > 0 ? (best + 1 == n ? 0 : best + 1)
+                            : (best == 0 ? n - 1 : best - 1);
+      double d = SegmentDist2(*this, next, x, y);
+      if (d >= best_d) break;
+      best = next;
+      best_d = d;
+    }
+  }
+  *hint = best;
+
+  size_t j = best + 1 == n ? 0 : best + 1;
+  double sx = xs[j] - xs[best];
+  double sy = ys[j] - ys[best];
+  if (heading) *heading = atan2(sy, sx);
+
+  // Positive when the point lies right of the segment direction.
+  double cross = sx * (y - ys[best]) - sy * (x - xs[best]);
+  double d = sqrt(best_d);
+  return cross > 0 ? -d : d;
+}
+
+double Track::Length() const {
+
+  double len = 0;
+  for (size_t i = 0; i < xs.size(); ++i) {
+    size_t j = (i + 1) % xs.size();
+    len += hypot(xs[j] - xs[i], ys[j] - ys[i]);
+  }
+  return len;
+}
@@ -0,0 +1,43 @@
+#ifndef TRACK_H
+#define TRACK_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+* Closed track described by its centerline, sampled roughly every meter.
+*/
+class Track {
+public:
+  /*
+  * Centerline vertices in meters, the last one connects back to the first.
+  */
+  std::vector<double> xs;
+  std::vector<double> ys;
+
+  /*
+  * Distance from the centerline to either edge of the road.
+  */
+  double half_width;
+
+  /*
+  * Built-in loop with a mix of long sweepers and tighter corners in both
+  * directions, about 1.4 km long.
+  */
+  static Track Default();
+
+  /*
+  * Signed cross track error of (x, y), positive when the point is right of
+  * the driving direction. hint carries the nearest segment between calls so
+  * that tracking a moving car costs O(1); heading receives the direction of
+  * the road at that point.
+  */
+  double Cte(double x, double y, size_t *hint, double *heading) const;
+
+  /*
+  * Arc length of the closed centerline.
+  */
+  double Length() const;
+};
+
+#endif /* TRACK_H */
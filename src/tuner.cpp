@@ -0,0 +1,523 @@
+#include "tuner.h"
+#include <limits>
+#include <math.h>
+#include <sstream>
+#include <string.h>
+#include "json.hpp"
+#include "reply_writer.h"
+
+// for convenience
+using json = nlohmann::json;
+
+Tuner::Tuner(const double p[kGains], const double dp[kGains], double tol,
+             int max_episodes)
+    : tol_(tol),
+      max_episodes_(max_episodes),
+      best_error_(std::numeric_limits<double>::infinity()) {
+  for (int i = 0; i < kGains; ++i) {
+    p0_[i] = p[i];
+    dp_[i] = dp[i];
+    best_.p[i] = p[i];
+  }
+}
+
+void Tuner::Ask(std::vector<Point> *batch) {
+
+  batch->clear();
+  if (!Done()) Propose(batch);
+  pending_ = *batch;
+}
+
+void Tuner::Tell(const std::vector<double> &errors) {
+
+  for (size_t i = 0; i < errors.size() && told_.size() < pending_.size();
+       ++i) {
+    if (errors[i] < best_error_) {
+      best_error_ = errors[i];
+      best_ = pending_[told_.size()];
+    }
+    told_.push_back(errors[i]);
+    history_.push_back(best_error_);
+  }
+  if (pending_.empty() || told_.size() < pending_.size()) return;
+  Learn(told_);
+  told_.clear();
+  pending_.clear();
+}
+
+bool Tuner::Done() const {
+  return episodes() >= max_episodes_ || Converged();
+}
+
+int Tuner::EpisodesToReach(double mse) const {
+  for (size_t i = 0; i < history_.size(); ++i) {
+    if (history_[i] <= mse) return static_cast<int>(i + 1);
+  }
+  return -1;
+}
+
+std::string Tuner::Save() const {
+
+  State state;
+  state["p0"].assign(p0_, p0_ + kGains);
+  state["dp"].assign(dp_, dp_ + kGains);
+  state["best"].assign(best_.p, best_.p + kGains);
+  state["best_error"].assign(1, best_error_);
+  state["history"] = history_;
+  state["told"] = told_;
+  std::vector<double> &pending = state["pending"];
+  for (const Point &point : pending_) {
+    pending.insert(pending.end(), point.p, point.p + kGains);
+  }
+  SaveState(&state);
+
+  // Written by hand: json.hpp rounds doubles to 15 digits.
+  std::string text = std::string("{\"tuner\":\"") + name() + "\"";
+  char number[kMaxDoubleLength];
+  for (const auto &entry : state) {
+    text += ",\n\"" + entry.first + "\":[";
+    for (size_t i = 0; i < entry.second.size(); ++i) {
+      if (i) text += ',';
+      text.append(number, FormatDouble(entry.second[i], number));
+    }
+    text += ']';
+  }
+  text += "}\n";
+  return text;
+}
+
+bool Tuner::Restore(const std::string &text, std::string *error) {
+
+  json j;
+  try {
+    j = json::parse(text);
+  } catch (const std::exception &e) {
+    *error = e.what();
+    return false;
+  }
+  if (!j.is_object() || !j.count("tuner") || !j["tuner"].is_string() ||
+      j["tuner"].get<std::string>() != name()) {
+    *error = std::string("not a ") + name() + " checkpoint";
+    return false;
+  }
+  State state;
+  for (auto it = j.begin(); it != j.end(); ++it) {
+    if (it.key() == "tuner") continue;
+    if (!it.value().is_array()) {
+      *error = "\"" + it.key() + "\" must be an array";
+      return false;
+    }
+    std::vector<double> &values = state[it.key()];
+    for (const json &v : it.value()) {
+      // Infinities are written as null.
+      if (v.is_null()) {
+        values.push_back(std::numeric_limits<double>::infinity());
+      } else if (v.is_number()) {
+        values.push_back(v.get<double>());
+      } else {
+        *error = "\"" + it.key() + "\" must hold numbers";
+        return false;
+      }
+    }
+  }
+
+  double best_error;
+  if (!Read(state, "p0", kGains, p0_) || !Read(state, "dp", kGains, dp_) ||
+      !Read(state, "best", kGains, best_.p) ||
+      !Read(state, "best_error", 1, &best_error) || !state.count("history") ||
+      !state.count("told") || !state.count("pending") ||
+      state["pending"].size() % kGains != 0 ||
+      state["told"].size() > state["pending"].size() / kGains) {
+    *error = "incomplete checkpoint";
+    return false;
+  }
+  best_error_ = best_error;
+  history_ = state["history"];
+  told_ = state["told"];
+  const std::vector<double> &pending = state["pending"];
+  pending_.resize(pending.size() / kGains);
+  for (size_t k = 0; k < pending_.size(); ++k) {
+    for (int i = 0; i < kGains; ++i) pending_[k].p[i] = pending[k * kGains + i];
+  }
+  if (!LoadState(state)) {
+    *error = std::string("bad ") + name() + " state";
+    return false;
+  }
+  return true;
+}
+
+bool Tuner::Read(const State &state, const char *key, size_t size,
+                 double *out) {
+  auto it = state.find(key);
+  if (it == state.end() || it->second.size() != size) return false;
+  for (size_t i = 0; i < size; ++i) out[i] = it->second[i];
+  return true;
+}
+
+void Tuner::SaveRng(const std::mt19937 &rng, std::vector<double> *out) {
+
+  // The state words are 32 bit, exact as doubles.
+  std::stringstream words;
+  words << rng;
+  out->clear();
+  double word;
+  while (words >> word) out->push_back(word);
+}
+
+bool Tuner::LoadRng(const std::vector<double> &in, std::mt19937 *rng) {
+
+  std::stringstream words;
+  for (double word : in) words << static_cast<unsigned long>(word) << ' ';
+  std::mt19937 loaded;
+  if (!(words >> loaded)) return false;
+  *rng = loaded;
+  return true;
+}
+
+Tuner::Point Tuner::ToGains(const double z[kGains]) const {
+  Point point;
+  for (int i = 0; i < kGains; ++i) point.p[i] = p0_[i] + z[i] * dp_[i];
+  return point;
+}
+
+const char *TunerKindName(TunerKind kind) {
+  switch (kind) {
+  case TunerKind::kNelderMead: return "nelder-mead";
+  case TunerKind::kCmaEs:      return "cma-es";
+  case TunerKind::kBayesian:   return "bayes";
+  case TunerKind::kTwiddle:
+  default:                     return "twiddle";
+  }
+}
+
+bool ParseTunerKind(const char *name, TunerKind *kind) {
+  const TunerKind kKinds[] = { TunerKind::kTwiddle, TunerKind::kNelderMead,
+                               TunerKind::kCmaEs, TunerKind::kBayesian };
+  for (TunerKind k : kKinds) {
+    if (!strcmp(name, TunerKindName(k))) {
+      *kind = k;
+      return true;
+    }
+  }
+  return false;
+}
+
+TunerOptions::TunerOptions()
+    : tol(0.0002), batch(1), max_episodes(1000), seed(1) {
+  p[0] = 0.212221;
+  p[1] = 0.00974437;
+  p[2] = 3.01065;
+  dp[0] = 0.01;
+  dp[1] = 0.001;
+  dp[2] = 0.01;
+  range[0] = 0.5;
+  range[1] = 0.05;
+  range[2] = 5;
+}
+
+std::unique_ptr<Tuner> MakeTuner(TunerKind kind, const TunerOptions &options) {
+  switch (kind) {
+  case TunerKind::kNelderMead:
+    return std::unique_ptr<Tuner>(new NelderMeadTuner(options));
+  case TunerKind::kCmaEs:
+    return std::unique_ptr<Tuner>(new CmaEsTuner(options));
+  case TunerKind::kBayesian:
+    return std::unique_ptr<Tuner>(new BayesianTuner(options));
+  case TunerKind::kTwiddle:
+  default:
+    return std::unique_ptr<Tuner>(new TwiddleTuner(options));
+  }
+}
+
+// Twiddle
+
+TwiddleTuner::TwiddleTuner(const TunerOptions &options)
+    : Tuner(options.p, options.dp, options.tol, options.max_episodes),
+      best_(std::numeric_limits<double>::infinity()),
+      idx_(0),
+      phase_(0) {
+  for (int i = 0; i < kGains; ++i) {
+    p_[i] = options.p[i];
+    step_[i] = options.dp[i];
+  }
+}
+
+double TwiddleTuner::step() const {
+  return step_[0] + step_[1] + step_[2];
+}
+
+double TwiddleTuner::bound() const {
+  // Probes only matter if they beat the current point.
+  return phase_ == 0 ? Tuner::bound() : best_;
+}
+
+void TwiddleTuner::Propose(std::vector<Point> *batch) {
+
+  Point point;
+  for (int i = 0; i < kGains; ++i) point.p[i] = p_[i];
+  if (phase_ == 1) point.p[idx_] += step_[idx_];
+  if (phase_ == 2) point.p[idx_] -= step_[idx_];
+  batch->push_back(point);
+}
+
+void TwiddleTuner::Learn(const std::vector<double> &errors) {
+
+  double err = errors[0];
+  if (phase_ == 0) {
+    best_ = err;
+    phase_ = 1;
+    return;
+  }
+  if (err < best_) {
+    best_ = err;
+    p_[idx_] += phase_ == 1 ? step_[idx_] : -step_[idx_];
+    step_[idx_] *= 1.1;
+  } else if (phase_ == 1) {
+    phase_ = 2;
+    return;
+  } else {
+    step_[idx_] *= 0.9;
+  }
+  phase_ = 1;
+  idx_ = (idx_ + 1) % kGains;
+}
+
+void TwiddleTuner::SaveState(State *state) const {
+  (*state)["p"].assign(p_, p_ + kGains);
+  (*state)["step"].assign(step_, step_ + kGains);
+  (*state)["error"].assign(1, best_);
+  (*state)["idx"].assign(1, idx_);
+  (*state)["phase"].assign(1, phase_);
+}
+
+bool TwiddleTuner::LoadState(const State &state) {
+  double idx, phase;
+  if (!Read(state, "p", kGains, p_) || !Read(state, "step", kGains, step_) ||
+      !Read(state, "error", 1, &best_) || !Read(state, "idx", 1, &idx) ||
+      !Read(state, "phase", 1, &phase)) {
+    return false;
+  }
+  idx_ = static_cast<int>(idx);
+  phase_ = static_cast<int>(phase);
+  return idx_ >= 0 && idx_ < kGains && phase_ >= 0 && phase_ <= 2;
+}
+
+// Nelder-Mead, on coordinates scaled by dp.
+
+namespace {
+
+const double kReflect = 1;
+const double kExpand = 2;
+const double kContract = 0.5;
+const double kShrink = 0.5;
+
+} // namespace
+
+NelderMeadTuner::NelderMeadTuner(const TunerOptions &options)
+    : Tuner(options.p, options.dp, options.tol, options.max_episodes),
+      speculative_(options.batch > 1),
+      stage_(Stage::kInit) {
+  for (int v = 0; v <= kGains; ++v) {
+    for (int i = 0; i < kGains; ++i) simplex_[v].z[i] = v == i + 1 ? 1 : 0;
+    simplex_[v].f = 0;
+  }
+}
+
+double NelderMeadTuner::step() const {
+
+  double sum = 0;
+  for (int i = 0; i < kGains; ++i) {
+    double lo = simplex_[0].z[i];
+    double hi = lo;
+    for (int v = 1; v <= kGains; ++v) {
+      lo = simplex_[v].z[i] < lo ? simplex_[v].z[i] : lo;
+      hi = simplex_[v].z[i] > hi ? simplex_[v].z[i] : hi;
+    }
+    sum += (hi - lo) * dp_[i];
+  }
+  return sum;
+}
+
+double NelderMeadTuner::bound() const {
+
+  // The value each single trial is compared against; past it the trial is
+  // discarded whatever its error.
+  switch (stage_) {
+  case Stage::kReflect:
+  case Stage::kInside:  return simplex_[kGains].f;
+  case Stage::kExpand:
+  case Stage::kOutside: return trial_[0].f;
+  default:              return Tuner::bound();
+  }
+}
+
+void NelderMeadTuner::Propose(std::vector<Point> *batch) {
+
+  switch (stage_) {
+  case Stage::kInit:
+    for (int v = 0; v <= kGains; ++v) batch->push_back(ToGains(simplex_[v].z));
+    break;
+  case Stage::kShrink:
+    for (int v = 1; v <= kGains; ++v) batch->push_back(ToGains(simplex_[v].z));
+    break;
+  case Stage::kSpeculative:
+    for (int t = 0; t < 4; ++t) batch->push_back(ToGains(trial_[t].z));
+    break;
+  case Stage::kReflect: batch->push_back(ToGains(trial_[0].z)); break;
+  case Stage::kExpand:  batch->push_back(ToGains(trial_[1].z)); break;
+  case Stage::kOutside: batch->push_back(ToGains(trial_[2].z)); break;
+  case Stage::kInside:  batch->push_back(ToGains(trial_[3].z)); break;
+  }
+}
+
+void NelderMeadTuner::Learn(const std::vector<double> &errors) {
+
+  switch (stage_) {
+  case Stage::kInit:
+    for (int v = 0; v <= kGains; ++v) simplex_[v].f = errors[v];
+    Next();
+    return;
+  case Stage::kShrink:
+    for (int v = 1; v <= kGains; ++v) simplex_[v].f = errors[v - 1];
+    Next();
+    return;
+  case Stage::kSpeculative:
+    for (int t = 0; t < 4; ++t) trial_[t].f = errors[t];
+    break;
+  case Stage::kReflect: trial_[0].f = errors[0]; break;
+  case Stage::kExpand:  trial_[1].f = errors[0]; break;
+  case Stage::kOutside: trial_[2].f = errors[0]; break;
+  case Stage::kInside:  trial_[3].f = errors[0]; break;
+  }
+
+  // The standard decision tree. Sequentially each step asks for the one
+  // trial it needs next; speculatively they are all known.
+  const Vertex &best = simplex_[0];
+  const Vertex &second = simplex_[kGains - 1];
+  const Vertex &worst = simplex_[kGains];
+  const Vertex &r = trial_[0];
+  if (stage_ == Stage::kReflect || stage_ == Stage::kSpeculative) {
+    if (r.f < best.f) {
+      if (stage_ == Stage::kReflect) {
+        stage_ = Stage::kExpand;
+        return;
+      }
+    } else if (r.f < second.f) {
+      Replace(r);
+      return;
+    } else if (stage_ == Stage::kReflect) {
+      stage_ = r.f < worst.f ? Stage::kOutside : Stage::kInside;
+      return;
+    }
+  }
+
+  if (r.f < best.f) {
+    Replace(trial_[1].f < r.f ? trial_[1] : r);
+  } else if (r.f < worst.f) {
+    if (trial_[2].f <= r.f) {
+      Replace(trial_[2]);
+    } else {
+      Shrink();
+    }
+  } else if (trial_[3].f < worst.f) {
+    Replace(trial_[3]);
+  } else {
+    Shrink();
+  }
+}
+
+void NelderMeadTuner::SaveState(State *state) const {
+
+  // Vertices and trials as z then f.
+  std::vector<double> &vertices = (*state)["simplex"];
+  std::vector<double> &trials = (*state)["trials"];
+  for (const Vertex &v : simplex_) {
+    vertices.insert(vertices.end(), v.z, v.z + kGains);
+    vertices.push_back(v.f);
+  }
+  for (const Vertex &v : trial_) {
+    trials.insert(trials.end(), v.z, v.z + kGains);
+    trials.push_back(v.f);
+  }
+  (*state)["centroid"].assign(centroid_, centroid_ + kGains);
+  (*state)["stage"].assign(1, static_cast<int>(stage_));
+  (*state)["speculative"].assign(1, speculative_);
+}
+
+bool NelderMeadTuner::LoadState(const State &state) {
+
+  const int kVertex = kGains + 1;
+  double vertices[(kGains + 1) * kVertex];
+  double trials[4 * kVertex];
+  double stage, speculative;
+  if (!Read(state, "simplex", (kGains + 1) * kVertex, vertices) ||
+      !Read(state, "trials", 4 * kVertex, trials) ||
+      !Read(state, "centroid", kGains, centroid_) ||
+      !Read(state, "stage", 1, &stage) ||
+      !Read(state, "speculative", 1, &speculative) ||
+      stage < 0 || stage > static_cast<int>(Stage::kSpeculative) ||
+      (speculative != 0) != speculative_) {
+    return false;
+  }
+  for (int v = 0; v <= kGains; ++v) {
+    const double *vertex = &vertices[v * kVertex];
+    for (int i = 0; i < kGains; ++i) simplex_[v].z[i] = vertex[i];
+    simplex_[v].f = vertex[kGains];
+  }
+  for (int t = 0; t < 4; ++t) {
+    const double *trial = &trials[t * kVertex];
+    for (int i = 0; i < kGains; ++i) trial_[t].z[i] = trial[i];
+    trial_[t].f = trial[kGains];
+  }
+  stage_ = static_cast<Stage>(static_cast<int>(stage));
+  return true;
+}
+
+void NelderMeadTuner::Order() {
+
+  for (int v = 1; v <= kGains; ++v) {
+    Vertex x = simplex_[v];
+    int w = v;
+    while (w > 0 && simplex_[w - 1].f > x.f) {
+      simplex_[w] = simplex_[w - 1];
+      --w;
+    }
+    simplex_[w] = x;
+  }
+}
+
+void NelderMeadTuner::Replace(const Vertex &v) {
+  simplex_[kGains] = v;
+  Next();
+}
+
+void NelderMeadTuner::Shrink() {
+
+  for (int v = 1; v <= kGains; ++v) {
+    for (int i = 0; i < kGains; ++i) {
+      simplex_[v].z[i] = simplex_[0].z[i] +
+                         kShrink * (simplex_[v].z[i] - simplex_[0].z[i]);
+    }
+  }
+  stage_ = Stage::kShrink;
+}
+
+void NelderMeadTuner::Next() {
+
+  Order();
+  for (int i = 0; i < kGains; ++i) {
+    double sum = 0;
+    for (int v = 0; v < kGains; ++v) sum += simplex_[v].z[i];
+    centroid_[i] = sum / kGains;
+  }
+  // Points along the line from the worst vertex through the centroid.
+  const double t[4] = { kReflect, kReflect * kExpand, kReflect * kContract,
+                        -kContract };
+  for (int k = 0; k < 4; ++k) {
+    for (int i = 0; i < kGains; ++i) {
+      trial_[k].z[i] =
+          centroid_[i] + t[k] * (centroid_[i] - simplex_[kGains].z[i]);
+    }
+  }
+  stage_ = speculative_ ? Stage::kSpeculative : Stage::kReflect;
+}
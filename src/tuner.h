@@ -0,0 +1,307 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+* Search over the three steering gains, driven from outside: Ask for a
+* batch of candidates, evaluate them in any order or in parallel, and Tell
+* their errors in the same order. Every backend works in gain units scaled
+* by the initial steps dp, and keeps the best candidate seen so far.
+*/
+class Tuner {
+public:
+  static const int kGains = 3;
+
+  struct Point {
+    double p[kGains];
+  };
+
+  virtual ~Tuner() {}
+
+  virtual const char *name() const = 0;
+
+  /*
+  * Candidates to evaluate next; empty once done. Ask is called again only
+  * after the whole batch is told.
+  */
+  void Ask(std::vector<Point> *batch);
+
+  /*
+  * Errors of the last batch in order, all at once or in parts; the backend
+  * learns from them once the batch is complete.
+  */
+  void Tell(const std::vector<double> &errors);
+
+  /*
+  * True once the step, summed over the gains, is below the tolerance or
+  * the episode budget is spent.
+  */
+  bool Done() const;
+
+  /*
+  * Current search step summed over the gains, in gain units; starts at
+  * the sum of dp.
+  */
+  virtual double step() const = 0;
+
+  /*
+  * Error above which the exact error of a pending candidate no longer
+  * matters: an episode may be stopped as soon as its partial error is
+  * above the bound, and told with that partial error. Infinite while
+  * every value is used.
+  */
+  virtual double bound() const {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  const Point &best() const { return best_; }
+  double best_error() const { return best_error_; }
+  int episodes() const { return static_cast<int>(history_.size()); }
+
+  /*
+  * Episodes evaluated until the best error first fell to mse or below, -1
+  * if it never did.
+  */
+  int EpisodesToReach(double mse) const;
+
+  /*
+  * The last batch asked for while it is being told, and how many of its
+  * errors are in.
+  */
+  const std::vector<Point> &pending() const { return pending_; }
+  size_t told() const { return told_.size(); }
+
+  /*
+  * The whole search state, pending candidates included, as JSON text with
+  * numbers that read back exactly. Restore loads it into a tuner made by
+  * MakeTuner with the same kind and batch; the tolerance and episode
+  * budget stay those of the new tuner. After a failed Restore the tuner
+  * must be discarded.
+  */
+  std::string Save() const;
+  bool Restore(const std::string &text, std::string *error);
+
+protected:
+  typedef std::map<std::string, std::vector<double>> State;
+
+  Tuner(const double p[kGains], const double dp[kGains], double tol,
+        int max_episodes);
+
+  virtual void Propose(std::vector<Point> *batch) = 0;
+  virtual void Learn(const std::vector<double> &errors) = 0;
+  virtual bool Converged() const { return step() < tol_; }
+
+  // Backend state under its own keys, for Save and Restore.
+  virtual void SaveState(State *state) const = 0;
+  virtual bool LoadState(const State &state) = 0;
+
+  // Copy exactly size values of key to out, false if it does not fit.
+  static bool Read(const State &state, const char *key, size_t size,
+                   double *out);
+  static void SaveRng(const std::mt19937 &rng, std::vector<double> *out);
+  static bool LoadRng(const std::vector<double> &in, std::mt19937 *rng);
+
+  // Between scaled coordinates, where dp is one unit, and gains.
+  Point ToGains(const double z[kGains]) const;
+
+  double p0_[kGains];
+  double dp_[kGains];
+  double tol_;
+  int max_episodes_;
+
+private:
+  std::vector<Point> pending_;
+  std::vector<double> told_;
+  std::vector<double> history_;   // best error after each episode
+  Point best_;
+  double best_error_;
+};
+
+/*
+* Backend selection and settings shared by all backends.
+*/
+enum class TunerKind {
+  kTwiddle,
+  kNelderMead,
+  kCmaEs,
+  kBayesian
+};
+
+const char *TunerKindName(TunerKind kind);
+bool ParseTunerKind(const char *name, TunerKind *kind);
+
+struct TunerOptions {
+  double p[Tuner::kGains];      // starting gains
+  double dp[Tuner::kGains];     // initial step per gain
+  double range[Tuner::kGains];  // bayes searches p +- range, clipped at 0
+  double tol;                   // stop once the summed step is below tol
+  int batch;                    // preferred candidates per Ask, 1 for online
+  int max_episodes;
+  unsigned seed;
+
+  TunerOptions();
+};
+
+std::unique_ptr<Tuner> MakeTuner(TunerKind kind, const TunerOptions &options);
+
+/*
+* Classic coordinate Twiddle, one candidate per Ask: try p + dp on one gain,
+* then p - dp if that did not improve; grow dp by 1.1 on success and
+* shrink it by 0.9 otherwise, then move to the next gain.
+*/
+class TwiddleTuner : public Tuner {
+public:
+  explicit TwiddleTuner(const TunerOptions &options);
+
+  const char *name() const override { return "twiddle"; }
+  double step() const override;
+  double bound() const override;
+
+  const double *dp() const { return step_; }
+
+protected:
+  void Propose(std::vector<Point> *batch) override;
+  void Learn(const std::vector<double> &errors) override;
+  void SaveState(State *state) const override;
+  bool LoadState(const State &state) override;
+
+private:
+  double p_[kGains];
+  double step_[kGains];
+  double best_;
+  int idx_;
+  int phase_;   // 0 baseline, 1 trying +dp, 2 trying -dp
+};
+
+/*
+* Nelder-Mead simplex with the standard coefficients, starting from p and
+* p + dp along each gain. With batch > 1 the reflection, expansion and both
+* contractions are evaluated together, trading episodes for wall time.
+*/
+class NelderMeadTuner : public Tuner {
+public:
+  explicit NelderMeadTuner(const TunerOptions &options);
+
+  const char *name() const override { return "nelder-mead"; }
+  double step() const override;
+  double bound() const override;
+
+protected:
+  void Propose(std::vector<Point> *batch) override;
+  void Learn(const std::vector<double> &errors) override;
+  void SaveState(State *state) const override;
+  bool LoadState(const State &state) override;
+
+private:
+  enum class Stage { kInit, kReflect, kExpand, kOutside, kInside, kShrink,
+                     kSpeculative };
+
+  struct Vertex {
+    double z[kGains];
+    double f;
+  };
+
+  bool speculative_;
+  Stage stage_;
+  Vertex simplex_[kGains + 1];
+  double centroid_[kGains];
+  Vertex trial_[4];   // reflection, expansion, outside, inside contraction
+
+  void Order();
+  void Replace(const Vertex &v);
+  void Shrink();
+  void Next();
+};
+
+/*
+* CMA-ES with the default population size (7 for three gains, or batch if
+* larger), weighted recombination, cumulative step size adaptation and
+* rank-one plus rank-mu covariance updates. A generation that would go past
+* max_episodes is cut short and only counts towards best().
+*/
+class CmaEsTuner : public Tuner {
+public:
+  explicit CmaEsTuner(const TunerOptions &options);
+
+  const char *name() const override { return "cma-es"; }
+  double step() const override;
+
+protected:
+  void Propose(std::vector<Point> *batch) override;
+  void Learn(const std::vector<double> &errors) override;
+  void SaveState(State *state) const override;
+  bool LoadState(const State &state) override;
+
+private:
+  int lambda_;
+  int mu_;
+  std::vector<double> weights_;
+  double mu_eff_, c_sigma_, d_sigma_, c_c_, c_1_, c_mu_, chi_n_;
+
+  double mean_[kGains];
+  double sigma_;
+  double c_[kGains][kGains];
+  double b_[kGains][kGains];   // eigenvectors of c_, by column
+  double d_[kGains];           // square roots of its eigenvalues
+  double p_sigma_[kGains];
+  double p_c_[kGains];
+  int generation_;
+  std::vector<double> y_;      // lambda_ steps from the mean, unscaled
+  std::mt19937 rng_;
+};
+
+/*
+* Bayesian optimization with a Gaussian process over the box p +- range:
+* squared exponential kernel on the log error, length scale picked by
+* marginal likelihood from a small grid, expected improvement maximized
+* over random and local candidates, and batches filled by the kriging
+* believer heuristic. Starts from p and a Latin hypercube of 2 * kGains
+* points, cut short if the budget is smaller, and never asks for more than
+* max_episodes or kMaxObservations episodes in total; the step is half the
+* box.
+*/
+class BayesianTuner : public Tuner {
+public:
+  static const int kMaxObservations = 120;
+
+  explicit BayesianTuner(const TunerOptions &options);
+
+  const char *name() const override { return "bayes"; }
+  double step() const override;
+
+protected:
+  void Propose(std::vector<Point> *batch) override;
+  void Learn(const std::vector<double> &errors) override;
+  void SaveState(State *state) const override;
+  bool LoadState(const State &state) override;
+  bool Converged() const override;
+
+private:
+  int batch_;
+  double lo_[kGains];
+  double hi_[kGains];
+  std::vector<double> x_;      // observed inputs in [-1, 1], kGains each
+  std::vector<double> y_;      // log errors
+  std::vector<double> asked_;  // inputs of the pending batch
+  std::mt19937 rng_;
+
+  // Model of the current fit, standardized targets.
+  double length_;
+  double y_mean_, y_scale_;
+  std::vector<double> chol_;
+  std::vector<double> alpha_;
+
+  void Fit(const std::vector<double> &x, const std::vector<double> &y);
+  double Factor(const std::vector<double> &x, double length,
+                std::vector<double> *chol) const;
+  void Predict(const std::vector<double> &x, const double *z, double *mean,
+               double *sd, std::vector<double> *scratch) const;
+};
+
+#endif /* TUNER_H */
@@ -0,0 +1,162 @@
+#include "twiddle.h"
+#include <limits>
+#include <random>
+
+TwiddleOptions::TwiddleOptions()
+    : tol(0.0002), steps(1000), restarts(1), seed(1), max_rounds(1000),
+      target_speed(Controller::kTargetSpeed) {
+  p[0] = 0.212221;
+  p[1] = 0.00974437;
+  p[2] = 3.01065;
+  dp[0] = 0.01;
+  dp[1] = 0.001;
+  dp[2] = 0.01;
+}
+
+double EvaluateGains(const Track &track, const Simulator::Params &params,
+                     const double p[3], int steps, unsigned seed,
+                     double target_speed, double bound) {
+
+  Controller controller;
+  controller.pid_steer.Init(p[0], p[1], p[2]);
+  controller.target_speed = target_speed;
+  Simulator sim(track, params, seed);
+  EpisodeResult r = RunEpisode(controller, sim, steps, false, bound * steps);
+  double err = r.cte_sq_sum;
+  if (r.off_track) {
+    err += (steps - r.steps) * track.half_width * track.half_width;
+  }
+  return err / steps;
+}
+
+namespace {
+
+struct Search {
+  double p[3];
+  double dp[3];
+  double best;
+  unsigned seed;
+  int rounds;
+  bool done;
+};
+
+struct Probe {
+  size_t search;
+  int idx;
+  double sign;
+  double err;
+};
+
+double Sum(const double v[3]) { return v[0] + v[1] + v[2]; }
+
+} // namespace
+
+TwiddleResult RunTwiddle(const Track &track, const TwiddleOptions &options,
+                         ThreadPool &pool) {
+
+  // Restarts other than the first start from a seeded perturbation of p.
+  std::mt19937 rng(options.seed);
+  std::uniform_real_distribution<double> jitter(-1, 1);
+  std::vector<Search> searches(options.restarts);
+  for (size_t s = 0; s < searches.size(); ++s) {
+    Search &search = searches[s];
+    for (int i = 0; i < 3; ++i) {
+      search.p[i] = options.p[i];
+      if (s > 0) search.p[i] += jitter(rng) * options.dp[i] * 5;
+      search.dp[i] = options.dp[i];
+    }
+    search.seed = options.seed;
+    search.rounds = 0;
+    search.done = false;
+  }
+
+  int episodes = static_cast<int>(searches.size());
+  pool.Run(searches.size(), [&](size_t s) {
+    searches[s].best = EvaluateGains(track, options.sim, searches[s].p,
+                                     options.steps, searches[s].seed,
+                                     options.target_speed);
+  });
+
+  std::vector<Probe> probes;
+  for (;;) {
+    probes.clear();
+    for (size_t s = 0; s < searches.size(); ++s) {
+      Search &search = searches[s];
+      search.done = search.done || Sum(search.dp) < options.tol ||
+                    search.rounds >= options.max_rounds;
+      if (search.done) continue;
+      for (int i = 0; i < 3; ++i) {
+        Probe up = { s, i, 1, 0 };
+        Probe down = { s, i, -1, 0 };
+        probes.push_back(up);
+        probes.push_back(down);
+      }
+    }
+    if (probes.empty()) break;
+
+    pool.Run(probes.size(), [&](size_t k) {
+      Probe &probe = probes[k];
+      const Search &search = searches[probe.search];
+      double p[3] = { search.p[0], search.p[1], search.p[2] };
+      p[probe.idx] += probe.sign * search.dp[probe.idx];
+      probe.err = EvaluateGains(track, options.sim, p, options.steps,
+                                search.seed, options.target_speed,
+                                search.best);
+    });
+    episodes += static_cast<int>(probes.size());
+
+    // Probes are grouped by search, six per search.
+    for (size_t k = 0; k < probes.size(); k += 6) {
+      Search &search = searches[probes[k].search];
+      const Probe *best = nullptr;
+      bool improved[3] = { false, false, false };
+      for (size_t j = k; j < k + 6; ++j) {
+        if (probes[j].err < search.best) {
+          improved[probes[j].idx] = true;
+          if (!best || probes[j].err < best->err) best = &probes[j];
+        }
+      }
+      if (best) {
+        search.p[best->idx] += best->sign * search.dp[best->idx];
+        search.dp[best->idx] *= 1.1;
+        search.best = best->err;
+      }
+      for (int i = 0; i < 3; ++i) {
+        if (!improved[i]) search.dp[i] *= 0.9;
+      }
+      search.rounds += 1;
+    }
+  }
+
+  const Search *winner = &searches[0];
+  for (size_t s = 1; s < searches.size(); ++s) {
+    if (searches[s].best < winner->best) winner = &searches[s];
+  }
+  TwiddleResult result;
+  for (int i = 0; i < 3; ++i) {
+    result.p[i] = winner->p[i];
+    result.dp[i] = winner->dp[i];
+  }
+  result.best_err = winner->best;
+  result.rounds = winner->rounds;
+  result.episodes = episodes;
+  return result;
+}
+
+void RunTuner(Tuner &tuner, const Track &track, const TwiddleOptions &options,
+              ThreadPool &pool) {
+
+  std::vector<Tuner::Point> batch;
+  std::vector<double> errors;
+  for (;;) {
+    tuner.Ask(&batch);
+    if (batch.empty()) break;
+    errors.resize(batch.size());
+    const double bound = tuner.bound();
+    pool.Run(batch.size(), [&](size_t k) {
+      errors[k] = EvaluateGains(track, options.sim, batch[k].p, options.steps,
+                                options.seed, options.target_speed, bound);
+    });
+    tuner.Tell(errors);
+  }
+}
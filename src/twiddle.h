@@ -0,0 +1,68 @@
+#ifndef TWIDDLE_H
+#define TWIDDLE_H
+
+#include <vector>
+#include "simulator.h"
+#include "thread_pool.h"
+#include "tuner.h"
+
+/*
+* Settings for an offline Twiddle run against the Simulator.
+*/
+struct TwiddleOptions {
+  double p[3];      // initial Kp, Ki, Kd
+  double dp[3];     // initial deltas
+  double tol;       // stop once dp[0] + dp[1] + dp[2] < tol
+  int steps;        // frames per episode
+  int restarts;     // independent searches, the first starts at p
+  unsigned seed;    // base seed for noise and restart perturbations
+  int max_rounds;   // safety limit on rounds per search
+  double target_speed;  // mph the car is driven at while tuning
+  Simulator::Params sim;
+
+  TwiddleOptions();
+};
+
+/*
+* Outcome of the best search.
+*/
+struct TwiddleResult {
+  double p[3];
+  double dp[3];
+  double best_err;
+  int rounds;
+  int episodes;   // episodes evaluated over all restarts
+};
+
+/*
+* Mean squared cte of one episode driven with the given steering gains. An
+* episode that leaves the road is charged the road half width squared for
+* every remaining frame. Once the error is sure to end up above bound the
+* episode stops, and the error so far, already above bound, is returned.
+*/
+double EvaluateGains(
+    const Track &track, const Simulator::Params &params, const double p[3],
+    int steps, unsigned seed, double target_speed = Controller::kTargetSpeed,
+    double bound = std::numeric_limits<double>::infinity());
+
+/*
+* Parallel Twiddle. Each round evaluates the +dp and -dp probes of all three
+* gains for every restart at once on the pool, then keeps the best improving
+* probe per restart, growing its delta by 1.1, and shrinks the deltas of the
+* gains that did not improve by 0.9. Every episode uses the same noise seed,
+* so results are comparable, deterministic and independent of the thread
+* count. Probes stop as soon as they cannot beat their search.
+*/
+TwiddleResult RunTwiddle(const Track &track, const TwiddleOptions &options,
+                         ThreadPool &pool);
+
+/*
+* Drive a Tuner offline until it is done. Every batch it asks for is
+* evaluated in parallel on the pool with EvaluateGains, using the steps,
+* seed, target speed and simulator settings of options, and stopped at the
+* tuner's bound.
+*/
+void RunTuner(Tuner &tuner, const Track &track, const TwiddleOptions &options,
+              ThreadPool &pool);
+
+#endif /* TWIDDLE_H */